@@ -54,9 +54,12 @@ namespace dimgel {
 		if (hasXPermisson) {
 			return addFile("has x-permission");
 		}
+		// Last path component (fileName) of regular file -- i.e. regName; see regNameOffset parameter of this class' methods.
+		// Says `man ldconfig`: "ldconfig will only look at files that are named lib*.so* (for regular shared objects)" ...
+		// But I'd rather look for "*.so" and "*.so.*".
 		std::string_view regName(path1 + regNameOffset, length - regNameOffset);
-		if (util::regex_match(regName, rLibName)) {
-			return addFile("matches .so regex");
+		if (util::isSharedLibName(regName)) {
+			return addFile("matches *.so or *.so.*");
 		}
 
 		return nullptr;
@@ -164,68 +167,52 @@ namespace dimgel {
 			}
 
 
-			class Task : public ThreadPool::Task {
-				FilesCollector& owner;
-				File& f;
-			public:
-				Task(FilesCollector& owner, File& f) : owner(owner), f(f) {}
-				void compute() override {
+			ctx.threadPool.parallelFor(std::span(uniqueFilesAddedByCurrentIteration), [&](File* pf) {
+				File& f = *pf;
 
-					// Inspect.
-					// --------
+				// Inspect.
+				// --------
 
-					owner.elfInspector.processOne_file(f, [&](SearchPath p) { owner.scanAdditionalDir(p); });
-					if (!f.isDynamicELF) {
-						return;
-					}
-
-					// Assign package & apply config.
-					// ------------------------------
+				elfInspector.processOne_file(f, [&](SearchPath p) { scanAdditionalDir(p); });
+				if (!f.isDynamicELF) {
+					return;
+				}
 
-					auto addLibsAndPaths = [&](std::vector<AddLibPath>& addList) {
-						for (AddLibPath& add : addList) {
-							SearchPath sp {.path1 = add.path0.substr(1), .inode = add.inode};
-							f.configPaths.push_back(sp);
-							if (sp.inode != 0) {
-								// 0 means directory does not exist, and was kept for optdeps.
-								owner.scanAdditionalDir(sp);
-							}
-							if (owner.ctx.verbosity >= Verbosity_Debug) {
-								owner.ctx.log.debug(FILE_LINE "`/%s`: add search path from config line %d: `%s`", f.path1.cp(), add.configLineNo, sp.path1.cp());
-							}
-						}
-					};
+				// Assign package & apply config.
+				// ------------------------------
 
-					if (auto it = owner.data.packagesByFilePath1.find(f.path1);  it != owner.data.packagesByFilePath1.end()) {
-						Package* p = f.belongsToPackage = it->second;
-						if (owner.ctx.verbosity >= Verbosity_Debug) {
-							owner.ctx.log.debug(FILE_LINE "`/%s`: assign package `%s %s`", f.path1.cp(), p->name.cp(), p->version.cp());
+				auto addLibsAndPaths = [&](std::vector<AddLibPath>& addList) {
+					for (AddLibPath& add : addList) {
+						SearchPath sp {.path1 = add.path0.substr(1), .inode = add.inode};
+						f.configPaths.push_back(sp);
+						if (sp.inode != 0) {
+							// 0 means directory does not exist, and was kept for optdeps.
+							scanAdditionalDir(sp);
 						}
-						// Apply per-package configuration.
-						if (auto it2 = owner.ctx.addLibPathsByPackage.find(p);  it2 != owner.ctx.addLibPathsByPackage.end()) {
-							addLibsAndPaths(it2->second);
+						if (ctx.verbosity >= Verbosity_Debug) {
+							ctx.log.debug(FILE_LINE "`/%s`: add search path from config line %d: `%s`", f.path1.cp(), add.configLineNo, sp.path1.cp());
 						}
 					}
+				};
 
-					// Apply per-filename configuration.
-					for (auto& [path1Pfx, addList] : owner.ctx.addLibPathsByFilePath1Prefix) {
-						if (f.path1 == path1Pfx || f.path1.sv().starts_with(path1Pfx.sv())) {
-							addLibsAndPaths(addList);
-						}
+				if (auto pp = data.packagesByFilePath1.find(f.path1.sv())) {
+					Package* p = f.belongsToPackage = *pp;
+					if (ctx.verbosity >= Verbosity_Debug) {
+						ctx.log.debug(FILE_LINE "`/%s`: assign package `%s %s`", f.path1.cp(), p->name.cp(), p->version.cp());
+					}
+					// Apply per-package configuration.
+					if (auto it2 = ctx.addLibPathsByPackage.find(p);  it2 != ctx.addLibPathsByPackage.end()) {
+						addLibsAndPaths(it2->second);
 					}
 				}
 
-				void merge() override {
+				// Apply per-filename configuration.
+				for (auto& [path1Pfx, addList] : ctx.addLibPathsByFilePath1Prefix) {
+					if (f.path1 == path1Pfx || f.path1.sv().starts_with(path1Pfx.sv())) {
+						addLibsAndPaths(addList);
+					}
 				}
-			};
-
-
-			std::vector<std::unique_ptr<ThreadPool::Task>> tasks;
-			tasks.reserve(uniqueFilesAddedByCurrentIteration.size());
-			for (File* f : uniqueFilesAddedByCurrentIteration) {
-				tasks.push_back(std::make_unique<Task>(*this, *f));
-			}
-			ctx.threadPool.addTasks(ctx.threadPool.groupTasks(std::move(tasks)));
+			});
 			ctx.threadPool.waitAll();
 			uniqueFilesAddedByCurrentIteration.clear();
 		}
@@ -283,25 +270,21 @@ namespace dimgel {
 
 			static_assert(std::numeric_limits<int>::max() > 999999999);
 
-			// github issue #2 fix: text is localized
-//			std::regex rFirstLine("^(\\d{1,9}) libs found in cache `/etc/ld.so.cache'$");
-			std::regex rFirstLine("^(\\d{1,9}) .*$");
-
-			std::cmatch m;
-			if (!util::regex_match(*it, m, rFirstLine)) {
+			// github issue #2 fix: text is localized, so matching "1234 libs found in cache `/etc/ld.so.cache'" only up to first space.
+			int numLibs;
+			if (!util::parseLdconfigFirstLine(it->sv(), numLibs)) {
 				throwParseError(__LINE__);
 			}
-			int numLibs = std::stoi(m[1]);
 			int numAdded = 0;
 			int numSkipped = 0;
 			data.ldCache.reserve(numLibs);
 
 			// For some libraries, `ldconfig -p` shows '(ELF)' instead of '(libc6[,x86-64])' even though `file {path}` correctly detects 32/64 bit.
 			// So I'm parsing type from `ldcontig -p` output, instead will use info from ELFInspector to detect bitness.
-			std::regex rLine("^\t(\\S+) \\([^\\)]+\\) => /(\\S+)$");
 			for (++it;  it != lines.end();  ++it) {
-				if (util::regex_match(*it, m, rLine)) {
-					std::string name = m[1];
+				std::string_view nameSV, path1SV;
+				if (util::parseLdconfigLine(it->sv(), nameSV, path1SV)) {
+					std::string name {nameSV};
 					// `man 8 ldconfig`: "ldconfig will only look at files that are named lib*.so* (for regular shared objects) or ld-*.so* (for the dynamic loader itself)"
 					// I don't need "dynamic loader ifself". But ld-linux.so.2 and ld-linux-x86-64.so.2 are statically linked, so they will be skipped by ELFInspector anyway.
 //					if (name.starts_with("ld-")) {
@@ -309,7 +292,7 @@ namespace dimgel {
 //						continue;
 //					}
 
-					std::string path1 = m[2];
+					std::string path1 {path1SV};
 					// Same scope as `path1`, because `path1` maybe reassigned to this buffer.
 					char path0Buf[PATH_MAX];
 
@@ -351,9 +334,9 @@ namespace dimgel {
 						f = processRegularFileAfterStatx(path1.c_str(), 0, path1.length(), st.mode, "found in `ldconfig -p`");
 					}
 
-					auto inserted = data.ldCache.insert({{alloc::String{ctx.mm, name}, f->is32}, f});
+					auto inserted = data.ldCache.insert({alloc::String{ctx.mm, name}, f->is32}, f);
 					if (!inserted.second) {
-						if (inserted.first->second == f) {
+						if (inserted.first == f) {
 							// Allow 100% duplicate (both key and value):
 							// I got duplicate {`ld-linux.so.2`, 32-bit}` ---> `/usr/lib32/ld-2.33.so` here
 							// because both /usr/lib/ld-linux.so.2 and /usr/lib32/ld-linux.so.2 are symlinks to /usr/lib32/ld-2.33.so
@@ -375,7 +358,7 @@ namespace dimgel {
 							if (ctx.verbosity >= Verbosity_WarnAndExec) {
 								ctx.log.warn(
 									FILE_LINE "`ldconfig -p` line %d: skip {`%s`, %s-bit} ---> `/%s`: duplicate key, keeping prev value `/%s`",
-									it.getPartNo(), name.c_str(), (f->is32 ? "32" : "64"), f->path1.cp(), inserted.first->second->path1.cp()
+									it.getPartNo(), name.c_str(), (f->is32 ? "32" : "64"), f->path1.cp(), inserted.first->path1.cp()
 								);
 							}
 						}
@@ -391,13 +374,10 @@ namespace dimgel {
 						);
 					}
 					continue;
-				} // if (regex_match(..., rLine))
+				} // if (parseLdconfigLine(...))
 
-				// github issue #2 fix: text is localized
-//				std::regex rLastLine("^Cache generated by: ldconfig \\(.*$");
-				std::regex rLastLine("^\\S.* ldconfig .*$");
-
-				if (!util::regex_match(*it, rLastLine) || ++it != lines.end()) {
+				// github issue #2 fix: text is localized, so not matching "Cache generated by: ldconfig (...".
+				if (!util::isLdconfigLastLine(it->sv()) || ++it != lines.end()) {
 					throwParseError(__LINE__);
 				}
 				break;
@@ -424,13 +404,17 @@ namespace dimgel {
 			if (!f->isLib) {
 				continue;
 			}
-			if (!data.libs.insert({PathAndBitnessKey{.path1 = path1, .is32 = f->is32}, f}).second) {
+			if (!data.libs.insert(PathAndBitnessKey{.path1 = path1, .is32 = f->is32}, f).second) {
 				throw Error(FILE_LINE "error adding lib {`%s`, %s-bit}: duplicate key", path1.cp(), (f->is32 ? "32" : "64"));
 			} else if (ctx.verbosity >= Verbosity_Debug) {
 				ctx.log.debug(FILE_LINE "add lib {`%s`, %s-bit} ---> `%s`", path1.cp(), (f->is32 ? "32" : "64"), f->path1.cp());
 			}
 		}
 
+		// From now on, Resolver only reads them (in parallel); PacMan adds a few entries to data.libs overflow.
+		data.libs.freeze();
+		data.ldCache.freeze();
+
 
 		if (ctx.verbosity >= Verbosity_Debug) {
 			ctx.log.debug(FILE_LINE "stats: processedDirs.size() = %lu", ulong{processedDirs.size()});
@@ -2,7 +2,6 @@
 
 #include <functional>
 #include <queue>
-#include <regex>
 #include <sys/stat.h>
 #include <unordered_set>
 #include "data.h"
@@ -26,12 +25,6 @@ namespace dimgel {
 		Data& data;
 		ELFInspector& elfInspector;
 
-		// Regex to match last path component (fileName) of regular file -- i.e. regName; see regNameOffset parameter of this class' methods.
-		// Says `man ldconfig`: "ldconfig will only look at files that are named lib*.so* (for regular shared objects)" ...
-		// But I'd rather look for "*.so" and "*.so.*".
-		const std::regex rLibName{"^.+\\.so(\\..*)?$"};
-
-
 		// 1. First we scan filesystem in main thread.
 		// 2. Only after scan is completed, we call ELFInspector-s in parallel.
 		// 3. ELFInspector-s can request more SearchPath-s to scan -- those it finds in ELFs' DT_RPATH and DT_RUNPATH entries.
@@ -70,7 +63,7 @@ namespace dimgel {
 		// 2. If `uniqueFilesAddedByCurrentIteration` is not empty (filled by step 1 or from `ldconfig -p`), run ELFInspector on these files & goto 1.
 		void processQueue();
 
-		// Called from ELFInspector::Task::compute() with File.rPath and File.runPath entries.
+		// Called in parallel from processQueue() with File.rPath and File.runPath entries.
 		void scanAdditionalDir(SearchPath searchPath) {
 			std::lock_guard g(queueSpinlock);
 			queue.push(searchPath);
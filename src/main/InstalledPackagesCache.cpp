@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <string.h>
+#include "InstalledPackagesCache.h"
+#include "util/Error.h"
+#include "util/util.h"
+
+#define FILE_LINE "InstalledPackagesCache:" LINE ": "
+
+
+namespace dimgel {
+
+	// File layout (see MappedCacheFile):
+	//     Header, then Header::numRecords records:
+	//         u32 recordSize, i64 mtime, str uniqueID, str name, str version, list provides, list optDepends, list filePaths1;
+	//     then zero padding up to Header::pathIndexOffset (multiple of 8), then path index of Header::numPathIndexEntries entries:
+	//         u64 pathHash[] (ascending), u32 recordIndex[] (0-based, in file order).
+	struct Header {
+		MappedCacheFile::HeaderPrefix prefix;
+		uint32_t numRecords;
+		int64_t rootMTime;
+		uint64_t pathIndexOffset;
+		uint64_t numPathIndexEntries;
+		uint64_t fileSize;
+	};
+
+	static constexpr MappedCacheFile::HeaderPrefix Prefix {{'C', 'L', 'C', 'P', 'K', 'G', 'S', '\0'}, InstalledPackagesCache::FormatVersion};
+
+
+	// Reads record starting at `p`, returns pointer past its end.
+	static const char* readRecord(const char* p, const char* end, InstalledPackagesCache::Entry& e) {
+		MappedCacheFile::Reader r(p, end);
+		r.beginRecord();
+		e.mtime = r.get<int64_t>();
+		e.uniqueID = r.str();
+		e.name = r.str();
+		e.version = r.str();
+		r.list(e.provides);
+		r.list(e.optDepends);
+		r.list(e.filePaths1);
+		return r.endRecord(e.uniqueID);
+	}
+
+
+	bool InstalledPackagesCache::load(const char* path) {
+		unload();
+
+		if (!file.load(path, Prefix, sizeof(Header))) {
+			return false;
+		}
+		try {
+			const char* begin = file.begin();
+			size_t mappingSize = file.size();
+			Header h;
+			memcpy(&h, begin, sizeof(h));
+			if (h.fileSize != mappingSize) {
+				throw Error(FILE_LINE "load(`%s`): malformed cache: file size mismatch", path);
+			}
+
+			// Validate all records and path index once, so get() and findOwners() never meet malformed data.
+			if (h.pathIndexOffset % 8 != 0 || h.pathIndexOffset < sizeof(Header) || h.pathIndexOffset > mappingSize
+					|| h.numPathIndexEntries > (mappingSize - h.pathIndexOffset) / (sizeof(uint64_t) + sizeof(uint32_t))
+					|| h.pathIndexOffset + h.numPathIndexEntries * (sizeof(uint64_t) + sizeof(uint32_t)) != mappingSize) {
+				throw Error(FILE_LINE "load(`%s`): malformed cache: bad path index bounds", path);
+			}
+			const char* recordsEnd = begin + h.pathIndexOffset;
+			recordsByUniqueID.reserve(h.numRecords);
+			records.reserve(h.numRecords);
+			Entry e;
+			const char* p = begin + sizeof(Header);
+			for (uint32_t i = 0;  i < h.numRecords;  i++) {
+				const char* next = readRecord(p, recordsEnd, e);
+				if (!recordsByUniqueID.insert({e.uniqueID, p}).second) {
+					throw Error(FILE_LINE "load(`%s`): malformed cache: duplicate record `%.*s`", path, (int)e.uniqueID.length(), e.uniqueID.data());
+				}
+				records.push_back(p);
+				p = next;
+			}
+			if ((size_t)(recordsEnd - p) >= 8) {
+				throw Error(FILE_LINE "load(`%s`): malformed cache: trailing data", path);
+			}
+
+			pathHashes = reinterpret_cast<const uint64_t*>(recordsEnd);
+			pathRecordIndexes = reinterpret_cast<const uint32_t*>(recordsEnd + h.numPathIndexEntries * sizeof(uint64_t));
+			numPathIndexEntries = h.numPathIndexEntries;
+			for (size_t i = 0;  i < numPathIndexEntries;  i++) {
+				if ((i > 0 && pathHashes[i] < pathHashes[i - 1]) || pathRecordIndexes[i] >= h.numRecords) {
+					throw Error(FILE_LINE "load(`%s`): malformed cache: bad path index entry %lu", path, ulong{i});
+				}
+			}
+			rootMTime = h.rootMTime;
+		} catch (...) {
+			unload();
+			throw;
+		}
+		return true;
+	}
+
+
+	void InstalledPackagesCache::unload() {
+		recordsByUniqueID.clear();
+		records.clear();
+		pathHashes = nullptr;
+		pathRecordIndexes = nullptr;
+		numPathIndexEntries = 0;
+		rootMTime = 0;
+		file.unload();
+	}
+
+
+	bool InstalledPackagesCache::get(std::string_view uniqueID, Entry& e) const {
+		auto it = recordsByUniqueID.find(uniqueID);
+		if (it == recordsByUniqueID.end()) {
+			return false;
+		}
+		readRecord(it->second, file.end(), e);
+		return true;
+	}
+
+
+	// FNV-1a: stored in file, so must not depend on std::hash implementation.
+	uint64_t InstalledPackagesCache::pathHash(std::string_view path1) noexcept {
+		uint64_t h = 0xCBF29CE484222325;
+		for (char c : path1) {
+			h = (h ^ (unsigned char)c) * 0x100000001B3;
+		}
+		return h;
+	}
+
+
+	void InstalledPackagesCache::findOwners(std::string_view path1, std::vector<std::string_view>& uniqueIDs) const {
+		uint64_t h = pathHash(path1);
+		auto first = std::lower_bound(pathHashes, pathHashes + numPathIndexEntries, h);
+		const char* end = reinterpret_cast<const char*>(pathHashes);
+		Entry e;
+		for (auto it = first;  it != pathHashes + numPathIndexEntries && *it == h;  ++it) {
+			readRecord(records[pathRecordIndexes[it - pathHashes]], end, e);
+			if (std::binary_search(e.filePaths1.begin(), e.filePaths1.end(), path1)) {
+				uniqueIDs.push_back(e.uniqueID);
+			}
+		}
+	}
+
+
+	void InstalledPackagesCache::save(const char* path, int64_t rootMTime, const std::vector<Entry>& entries) {
+		using W = MappedCacheFile::Writer;
+		auto recordSize = [](const Entry& e) {
+			return W::recordSize(
+				sizeof(uint32_t) + sizeof(int64_t) + W::strSize(e.uniqueID) + W::strSize(e.name) + W::strSize(e.version)
+						+ W::listSize(e.provides) + W::listSize(e.optDepends) + W::listSize(e.filePaths1),
+				e.uniqueID
+			);
+		};
+		size_t recordsEnd = sizeof(Header);
+		for (auto& e : entries) {
+			recordsEnd += recordSize(e);
+		}
+		size_t pathIndexOffset = (recordsEnd + 7) & ~size_t{7};
+
+		std::vector<std::pair<uint64_t, uint32_t>> pathIndex;
+		for (uint32_t i = 0;  i < (uint32_t)entries.size();  i++) {
+			for (auto s : entries[i].filePaths1) {
+				pathIndex.push_back({pathHash(s), i});
+			}
+		}
+		std::sort(pathIndex.begin(), pathIndex.end());
+
+		MappedCacheFile::save(path, [&](W& w) {
+			Header h {};
+			h.prefix = Prefix;
+			h.numRecords = (uint32_t)entries.size();
+			h.rootMTime = rootMTime;
+			h.pathIndexOffset = pathIndexOffset;
+			h.numPathIndexEntries = pathIndex.size();
+			h.fileSize = pathIndexOffset + pathIndex.size() * (sizeof(uint64_t) + sizeof(uint32_t));
+			w.put(h);
+			for (auto& e : entries) {
+				w.put(recordSize(e));
+				w.put(e.mtime);
+				w.str(e.uniqueID);
+				w.str(e.name);
+				w.str(e.version);
+				w.list(e.provides);
+				w.list(e.optDepends);
+				w.list(e.filePaths1);
+			}
+			w.zeros(pathIndexOffset - recordsEnd);
+			for (auto& [hash, _] : pathIndex) {
+				w.put(hash);
+			}
+			for (auto& [_, recordIndex] : pathIndex) {
+				w.put(recordIndex);
+			}
+		});
+	}
+}
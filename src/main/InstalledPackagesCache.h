@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "util/MappedCacheFile.h"
+
+
+namespace dimgel {
+
+	// Persistent cache of parsed installed packages database, see PacMan::parseInstalledPackages().
+	// Database changes only when package manager runs, so warm run mmap()-s single file instead of reading ~3000 small ones.
+	//
+	// Validation is up to caller: each entry keeps `mtime` of its package, and whole cache keeps `rootMTime` of database.
+	// Cached file lists are already filtered by PacMan::isOwnedFileRelevant(), so FormatVersion must be bumped when that filter changes.
+	//
+	// Also keeps path index: hashes of all file paths sorted, each with its record. So findOwners() (lazy ownership mode, which never
+	// builds data.packagesByFilePath1) binary-searches it and reads only records with matching hash, instead of every package's file list.
+	//
+	// All string_view-s returned by get() point into mapping and are valid until unload() or destructor. get() may be called in parallel.
+	class InstalledPackagesCache final {
+	public:
+		static constexpr uint32_t FormatVersion = 2;
+
+		struct Entry {
+			std::string_view uniqueID;
+			int64_t mtime;
+			std::string_view name;
+			std::string_view version;
+			std::vector<std::string_view> provides;
+			std::vector<std::string_view> optDepends;
+			std::vector<std::string_view> filePaths1;   // Sorted.
+		};
+
+	private:
+		MappedCacheFile file;
+		int64_t rootMTime = 0;
+		// Value = record start inside mapping.
+		std::unordered_map<std::string_view, const char*> recordsByUniqueID;
+		// Record starts in file order, referenced by path index.
+		std::vector<const char*> records;
+		// Path index inside mapping: pathHashes[i] ascending, pathRecordIndexes[i] is index in `records`.
+		const uint64_t* pathHashes = nullptr;
+		const uint32_t* pathRecordIndexes = nullptr;
+		size_t numPathIndexEntries = 0;
+
+		static uint64_t pathHash(std::string_view path1) noexcept;
+
+	public:
+		InstalledPackagesCache() = default;
+		InstalledPackagesCache(const InstalledPackagesCache&) = delete;
+		InstalledPackagesCache& operator =(const InstalledPackagesCache&) = delete;
+		~InstalledPackagesCache() { unload(); }
+
+		// Returns false if file does not exist. Throws if it's malformed or has other FormatVersion; cache is left empty then.
+		bool load(const char* path);
+		void unload();
+
+		int64_t getRootMTime() const noexcept { return rootMTime; }
+		const std::unordered_map<std::string_view, const char*>& getRecordsByUniqueID() const noexcept { return recordsByUniqueID; }
+
+		// Returns false if not found.
+		bool get(std::string_view uniqueID, Entry& e) const;
+
+		// Appends to `uniqueIDs` packages whose cached file list contains `path1`. May be called in parallel.
+		void findOwners(std::string_view path1, std::vector<std::string_view>& uniqueIDs) const;
+
+		// See MappedCacheFile::save().
+		static void save(const char* path, int64_t rootMTime, const std::vector<Entry>& entries);
+	};
+}
@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <string.h>
+#include "OptDependsArchivesCache.h"
+#include "util/Error.h"
+#include "util/util.h"
+
+#define FILE_LINE "OptDependsArchivesCache:" LINE ": "
+
+
+namespace dimgel {
+
+	// File layout (see MappedCacheFile):
+	//     Header, then Header::numRecords records:
+	//         u32 recordSize, u64 size, i64 mtime, str archiveName, str name, str version, list provides,
+	//         u32 numSymlinks + (str path1, str target)[numSymlinks], list filePaths1, u32 numInspectedFiles + (str path1, u8 flags)[numInspectedFiles]
+	//     where flags = Flag_* bits.
+	struct Header {
+		MappedCacheFile::HeaderPrefix prefix;
+		uint32_t numRecords;
+		uint64_t fileSize;
+	};
+
+	static constexpr MappedCacheFile::HeaderPrefix Prefix {{'C', 'L', 'C', 'O', 'P', 'T', 'D', '\0'}, OptDependsArchivesCache::FormatVersion};
+
+	enum : uint8_t {
+		Flag_IsDynamicELF = 1,
+		Flag_IsLib = 2,
+		Flag_Is32 = 4,
+	};
+
+
+	// Reads record starting at `p`, returns pointer past its end.
+	static const char* readRecord(const char* p, const char* end, OptDependsArchivesCache::Entry& e) {
+		MappedCacheFile::Reader r(p, end);
+		r.beginRecord();
+		e.size = r.get<uint64_t>();
+		e.mtime = r.get<int64_t>();
+		e.archiveName = r.str();
+		e.name = r.str();
+		e.version = r.str();
+		r.list(e.provides);
+
+		auto numSymlinks = r.get<uint32_t>();
+		e.symlinks.clear();
+		e.symlinks.reserve(numSymlinks);
+		for (uint32_t i = 0;  i < numSymlinks;  i++) {
+			auto path1 = r.str();
+			e.symlinks.push_back({path1, r.str()});
+		}
+
+		r.list(e.filePaths1);
+
+		auto numInspectedFiles = r.get<uint32_t>();
+		e.inspectedFiles.clear();
+		e.inspectedFiles.reserve(numInspectedFiles);
+		for (uint32_t i = 0;  i < numInspectedFiles;  i++) {
+			auto path1 = r.str();
+			auto flags = r.get<uint8_t>();
+			e.inspectedFiles.push_back({
+				.path1 = path1, .isDynamicELF = (flags & Flag_IsDynamicELF) != 0, .isLib = (flags & Flag_IsLib) != 0, .is32 = (flags & Flag_Is32) != 0
+			});
+		}
+
+		return r.endRecord(e.archiveName);
+	}
+
+
+	const OptDependsArchivesCache::InspectedFile* OptDependsArchivesCache::Entry::findInspectedFile(std::string_view path1) const noexcept {
+		auto it = std::lower_bound(inspectedFiles.begin(), inspectedFiles.end(), path1, [](auto& f, std::string_view p) { return f.path1 < p; });
+		return it != inspectedFiles.end() && it->path1 == path1 ? &*it : nullptr;
+	}
+
+
+	bool OptDependsArchivesCache::load(const char* path) {
+		unload();
+
+		if (!file.load(path, Prefix, sizeof(Header))) {
+			return false;
+		}
+		try {
+			const char* begin = file.begin();
+			const char* end = file.end();
+			Header h;
+			memcpy(&h, begin, sizeof(h));
+			if (h.fileSize != file.size()) {
+				throw Error(FILE_LINE "load(`%s`): malformed cache: file size mismatch", path);
+			}
+
+			// Validate all records once, so get() never meets malformed data.
+			recordsByArchiveName.reserve(h.numRecords);
+			Entry e;
+			const char* p = begin + sizeof(Header);
+			for (uint32_t i = 0;  i < h.numRecords;  i++) {
+				const char* next = readRecord(p, end, e);
+				if (!recordsByArchiveName.insert({e.archiveName, p}).second) {
+					throw Error(FILE_LINE "load(`%s`): malformed cache: duplicate record `%.*s`", path, (int)e.archiveName.length(), e.archiveName.data());
+				}
+				p = next;
+			}
+			if (p != end) {
+				throw Error(FILE_LINE "load(`%s`): malformed cache: trailing data", path);
+			}
+		} catch (...) {
+			unload();
+			throw;
+		}
+		return true;
+	}
+
+
+	void OptDependsArchivesCache::unload() {
+		recordsByArchiveName.clear();
+		file.unload();
+	}
+
+
+	bool OptDependsArchivesCache::get(std::string_view archiveName, Entry& e) const {
+		auto it = recordsByArchiveName.find(archiveName);
+		if (it == recordsByArchiveName.end()) {
+			return false;
+		}
+		readRecord(it->second, file.end(), e);
+		return true;
+	}
+
+
+	void OptDependsArchivesCache::save(const char* path, const std::vector<Entry>& entries) {
+		using W = MappedCacheFile::Writer;
+		auto recordSize = [](const Entry& e) {
+			size_t n = sizeof(uint32_t) + sizeof(uint64_t) + sizeof(int64_t) + W::strSize(e.archiveName) + W::strSize(e.name) + W::strSize(e.version)
+					+ W::listSize(e.provides) + sizeof(uint32_t) + W::listSize(e.filePaths1) + sizeof(uint32_t);
+			for (auto& [path1, target] : e.symlinks) {
+				n += W::strSize(path1) + W::strSize(target);
+			}
+			for (auto& f : e.inspectedFiles) {
+				n += W::strSize(f.path1) + sizeof(uint8_t);
+			}
+			return W::recordSize(n, e.archiveName);
+		};
+		size_t fileSize = sizeof(Header);
+		for (auto& e : entries) {
+			fileSize += recordSize(e);
+		}
+
+		MappedCacheFile::save(path, [&](W& w) {
+			Header h {};
+			h.prefix = Prefix;
+			h.numRecords = (uint32_t)entries.size();
+			h.fileSize = fileSize;
+			w.put(h);
+			for (auto& e : entries) {
+				w.put(recordSize(e));
+				w.put(e.size);
+				w.put(e.mtime);
+				w.str(e.archiveName);
+				w.str(e.name);
+				w.str(e.version);
+				w.list(e.provides);
+				w.put((uint32_t)e.symlinks.size());
+				for (auto& [path1, target] : e.symlinks) {
+					w.str(path1);
+					w.str(target);
+				}
+				w.list(e.filePaths1);
+				w.put((uint32_t)e.inspectedFiles.size());
+				for (auto& f : e.inspectedFiles) {
+					w.str(f.path1);
+					w.put((uint8_t)((f.isDynamicELF ? Flag_IsDynamicELF : 0) | (f.isLib ? Flag_IsLib : 0) | (f.is32 ? Flag_Is32 : 0)));
+				}
+			}
+		});
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "util/MappedCacheFile.h"
+
+
+namespace dimgel {
+
+	// Persistent cache of inspected optdepend archives, see PacMan::processOptionalDependencies().
+	// Archive contents never change for given archive name, so warm run does not decompress anything; and cache outlives archives themselves,
+	// so pruning package manager's archive cache does not cost re-download as long as cached entry is enough to answer.
+	//
+	// Entry keeps what ParseArchiveTask callbacks need to replay parsing: package metadata, all symlinks, all regular files passing
+	// PacMan::isOwnedFileRelevant() (so FormatVersion must be bumped when that filter changes), and ELF summary of each regular file
+	// ever inspected. Which files are needed depends on data.unresolvedNeededLibNames, so entry may lack some summaries; then archive is re-parsed.
+	//
+	// Validation is up to caller: each entry keeps size and mtime of its archive.
+	// All string_view-s returned by get() point into mapping and are valid until unload() or destructor. get() may be called in parallel.
+	class OptDependsArchivesCache final {
+	public:
+		static constexpr uint32_t FormatVersion = 1;
+
+		struct InspectedFile {
+			std::string_view path1;
+			bool isDynamicELF;
+			bool isLib;
+			bool is32;
+		};
+
+		struct Entry {
+			std::string_view archiveName;
+			uint64_t size;
+			int64_t mtime;
+			std::string_view name;
+			std::string_view version;
+			std::vector<std::string_view> provides;
+			std::vector<std::pair<std::string_view, std::string_view>> symlinks;   // {path1, target as stored in archive}
+			std::vector<std::string_view> filePaths1;                              // Sorted.
+			std::vector<InspectedFile> inspectedFiles;                             // Sorted by path1.
+
+			// Returns nullptr if not found.
+			const InspectedFile* findInspectedFile(std::string_view path1) const noexcept;
+		};
+
+	private:
+		MappedCacheFile file;
+		// Value = record start inside mapping.
+		std::unordered_map<std::string_view, const char*> recordsByArchiveName;
+
+	public:
+		OptDependsArchivesCache() = default;
+		OptDependsArchivesCache(const OptDependsArchivesCache&) = delete;
+		OptDependsArchivesCache& operator =(const OptDependsArchivesCache&) = delete;
+		~OptDependsArchivesCache() { unload(); }
+
+		// Returns false if file does not exist. Throws if it's malformed or has other FormatVersion; cache is left empty then.
+		bool load(const char* path);
+		void unload();
+
+		const std::unordered_map<std::string_view, const char*>& getRecordsByArchiveName() const noexcept { return recordsByArchiveName; }
+
+		// Returns false if not found.
+		bool get(std::string_view archiveName, Entry& e) const;
+
+		// See MappedCacheFile::save().
+		static void save(const char* path, const std::vector<Entry>& entries);
+	};
+}
@@ -1,3 +1,7 @@
+#include <algorithm>
+#include <queue>
+#include <unordered_set>
+#include "InstalledPackagesCache.h"
 #include "util/Abort.h"
 #include "util/Error.h"
 #include "util/util.h"
@@ -9,70 +13,155 @@
 
 namespace dimgel {
 
+	bool PacMan::isOwnedFileRelevant(std::string_view filePath1) {
+		// NOTE: Cannot filter by scanBins / scanDefaultLibs / scanMoreLibs / addLibPath prefixes: FilesCollector looks up realpaths,
+		//       and scans directories from RPATH & RUNPATH; so ELF-s found via symlinks or RPATH can be anywhere.
+		//       So filtering only directory trees and extensions which never contain ELF-s, which is still the bulk of %FILES% entries.
+		static constexpr std::string_view irrelevantPrefixes[] {
+			"usr/include/",
+			"usr/share/doc/",
+			"usr/share/fonts/",
+			"usr/share/gtk-doc/",
+			"usr/share/help/",
+			"usr/share/i18n/",
+			"usr/share/icons/",
+			"usr/share/info/",
+			"usr/share/licenses/",
+			"usr/share/locale/",
+			"usr/share/man/",
+			"usr/share/zoneinfo/",
+		};
+		static constexpr std::string_view irrelevantExtensions[] {
+			".a", ".c", ".css", ".desktop", ".gz", ".h", ".hpp", ".html", ".js", ".json", ".mo", ".pl", ".pm",
+			".png", ".py", ".pyc", ".pyi", ".rb", ".svg", ".txt", ".xml", ".xz", ".zst",
+		};
+
+		for (auto pfx : irrelevantPrefixes) {
+			if (filePath1.starts_with(pfx)) {
+				return false;
+			}
+		}
+		auto iSlash = filePath1.rfind('/');
+		auto iDot = filePath1.rfind('.');
+		if (iDot != std::string_view::npos && (iSlash == std::string_view::npos || iDot > iSlash)) {
+			auto ext = filePath1.substr(iDot);
+			for (auto e : irrelevantExtensions) {
+				if (ext == e) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+
+	//----------------------------------------------------------------------------------------------------------------------------------------
+
+
 	void PacMan::parseInstalledPackages() {
 		if (ctx.verbosity >= Verbosity_Default) {
 			ctx.log.info("Analyzing installed packages...");
 		}
 
-		class Task : public ThreadPool::Task {
-			PacMan& owner;
-			std::string installedPackageUniqueID;
-			parseInstalledPackage_Result result;
-
-		public:
-			// Parameter packageDirName will be initialized with temporary value that won't live for the lifetime of this Task; so it's passed by value.
-			// Othere parameters are OK to be passed by reference: they all are in scope while tasks work, i.e. until threadPool.waitAll() is called.
-			Task(PacMan& owner, std::string installedPackageUniqueID)
-				: owner(owner), installedPackageUniqueID(std::move(installedPackageUniqueID))
-			{
+		// Load cache. If database mtime did not change, then set of packages did not change either, and all cached entries are valid.
+		// Otherwise each cached entry is validated by its package mtime.
+		// Cached file paths point into cache mapping, so it must live until k-way merge below is done (or until lazy lookups are done).
+		auto& cache = installedPackagesCache;
+		int64_t rootMTime = installedPackagesRootMTime = getInstalledPackagesMTime();
+		bool isCacheLoaded = false;
+		try {
+			isCacheLoaded = cache.load(getInstalledPackagesCachePath());
+		} catch (std::exception& e) {
+			if (ctx.verbosity >= Verbosity_WarnAndExec) {
+				ctx.log.warn(FILE_LINE "ignoring installed packages cache: %s", e.what());
 			}
+		}
+		bool trustCache = trustInstalledPackagesCache = isCacheLoaded && cache.getRootMTime() == rootMTime;
 
-			// Throws if anything's wrong -- which means some package file is malformed, and there's no much point in proceeding.
-			void compute() override {
-				result = owner.parseInstalledPackage(installedPackageUniqueID);
-			}
+		// Sorted file lists of all packages, taken by mergeParsed() for final k-way merge into data.packagesByFilePath1.
+		std::vector<parseInstalledPackage_Result> results;
 
+		// Throws if anything's wrong -- which means some package file is malformed, and there's no much point in proceeding.
+		auto parseOne = [&](std::vector<parseInstalledPackage_Result>& parsed, const std::string& installedPackageUniqueID) {
+			InstalledPackagesCache::Entry e;
+			bool isCached = cache.get(installedPackageUniqueID, e);
+			// Taking mtime before parsing: if package is modified meanwhile, next run will see mtime mismatch.
+			int64_t mtime = isCached && trustCache ? e.mtime : getInstalledPackageMTime(installedPackageUniqueID);
 
-			void merge() override {
-				if (result.p->name.empty()) {
-					throw Error(FILE_LINE "read `%s`: empty package name", installedPackageUniqueID.c_str());
+			parseInstalledPackage_Result result;
+			if (isCached && e.mtime == mtime) {
+				auto& mm = ctx.mm;
+				result.p = Package::create(mm);
+				result.p->name = alloc::String{mm, e.name};
+				result.p->version = alloc::String{mm, e.version};
+				for (auto s : e.provides) {
+					result.p->provides.insert(alloc::String{mm, s});
+				}
+				for (auto s : e.optDepends) {
+					result.p->optDepends.insert(alloc::String{mm, s});
 				}
-				if (result.p->version.empty()) {
-					throw Error(FILE_LINE "read `%s`: empty package version", installedPackageUniqueID.c_str());
+				if (!ctx.lazyOwnership) {
+					result.filePaths1 = std::move(e.filePaths1);
 				}
+				result.isFromCache = true;
+			} else {
+				result = parseInstalledPackage(installedPackageUniqueID, !ctx.lazyOwnership);
+				std::sort(result.filePaths1.begin(), result.filePaths1.end());
+			}
+			if (result.p->name.empty()) {
+				throw Error(FILE_LINE "read `%s`: empty package name", installedPackageUniqueID.c_str());
+			}
+			if (result.p->version.empty()) {
+				throw Error(FILE_LINE "read `%s`: empty package version", installedPackageUniqueID.c_str());
+			}
+			result.installedPackageUniqueID = installedPackageUniqueID;
+			result.mtime = mtime;
+			parsed.push_back(std::move(result));
+		};
+
+
+		// Called in parallel for different pairs of workers' results, so merge is called once.
+		auto combineParsed = [](std::vector<parseInstalledPackage_Result>& into, std::vector<parseInstalledPackage_Result>& from) {
+			into.insert(into.end(), std::make_move_iterator(from.begin()), std::make_move_iterator(from.end()));
+		};
+
+
+		auto mergeParsed = [&](std::vector<parseInstalledPackage_Result>& parsed) {
+			for (auto& result : parsed) {
+				auto installedPackageUniqueID = result.installedPackageUniqueID.c_str();
 //				if (!std::regex_match(result.p->name, rPackageName)) {
-//					throw Error(FILE_LINE "read `%s`: invalid package name", installedPackageUniqueID.c_str());
+//					throw Error(FILE_LINE "read `%s`: invalid package name", installedPackageUniqueID);
 //				}
 //				if (!std::regex_match(result.p->version, rPackageVersion)) {
-//					throw Error(FILE_LINE "read `%s`: invalid package version", installedPackageUniqueID.c_str());
+//					throw Error(FILE_LINE "read `%s`: invalid package version", installedPackageUniqueID);
 //				}
 
-				if (owner.ctx.verbosity >= Verbosity_Debug) {
-					owner.ctx.log.debug(FILE_LINE "read `%s`: package `%s %s`", installedPackageUniqueID.c_str(), result.p->name.cp(), result.p->version.cp());
+				if (ctx.verbosity >= Verbosity_Debug) {
+					ctx.log.debug(FILE_LINE "read `%s`: package `%s %s`", installedPackageUniqueID, result.p->name.cp(), result.p->version.cp());
 					for (auto& s : result.p->provides) {
-						owner.ctx.log.debug(FILE_LINE "read `%s`: provides `%s`", installedPackageUniqueID.c_str(), s.cp());
+						ctx.log.debug(FILE_LINE "read `%s`: provides `%s`", installedPackageUniqueID, s.cp());
 					}
 					for (auto& s : result.p->optDepends) {
-						owner.ctx.log.debug(FILE_LINE "read `%s`: optDepends `%s`", installedPackageUniqueID.c_str(), s.cp());
+						ctx.log.debug(FILE_LINE "read `%s`: optDepends `%s`", installedPackageUniqueID, s.cp());
 					}
 				}
 
-				if (auto t2 = owner.data.packagesByName.insert({result.p->name, result.p});  !t2.second) {
+				if (auto t2 = data.packagesByName.insert({result.p->name, result.p});  !t2.second) {
 					auto p0 = t2.first->second;
 					throw Error(
 						FILE_LINE "read `%s`: another installed package has same name: `%s %s`",
-						installedPackageUniqueID.c_str(), p0->name.cp(), p0->version.cp()
+						installedPackageUniqueID, p0->name.cp(), p0->version.cp()
 					);
 				}
 
 				auto insertByProvides = [&](alloc::String s) {
-					if (auto t2 = owner.data.packagesByProvides.insert({s, result.p});  !t2.second && owner.ctx.verbosity >= Verbosity_Debug) {
+					if (auto t2 = data.packagesByProvides.insert({s, result.p});  !t2.second && ctx.verbosity >= Verbosity_Debug) {
 						// This is legal: e.g. `nvidia-utils` & `vulkan-intel` both provide `vulkan-driver`; currently there are 10 such "conflicts" on my system.
 						// And I actually don't care who provides dependency; I'll only download dependencies provided by nobody.
 						auto p0 = t2.first->second;
-						owner.ctx.log.debug(
+						ctx.log.debug(
 							FILE_LINE "read `%s`: another installed package already provides `%s`: `%s %s`",
-							installedPackageUniqueID.c_str(), s.cp(), p0->name.cp(), p0->version.cp()
+							installedPackageUniqueID, s.cp(), p0->name.cp(), p0->version.cp()
 						);
 					}
 				};
@@ -81,40 +170,95 @@ namespace dimgel {
 					insertByProvides(s);
 				}
 
-				for (auto s : result.filePaths1) {
-					if (auto t2 = owner.data.packagesByFilePath1.insert({s, result.p});  !t2.second) {
-						// This was a warning once, but from pacman's point of view it's error.
-						// Don't know if `pacman -Qkk` checks for it, won't be bad to fail-fast here anyway.
-						auto p0 = t2.first->second;
-						throw Error(
-							FILE_LINE "read `%s`: another installed package already owns file `%s`: `%s %s`",
-							installedPackageUniqueID.c_str(), s.cp(), p0->name.cp(), p0->version.cp()
-						);
-					}
-					if (owner.ctx.verbosity >= Verbosity_Debug) {
-						owner.ctx.log.debug(FILE_LINE "read `%s`: owns file `%s`", installedPackageUniqueID.c_str(), s.cp());
+				if (ctx.verbosity >= Verbosity_Debug) {
+					for (auto s : result.filePaths1) {
+						ctx.log.debug(FILE_LINE "read `%s`: owns file `%.*s`", installedPackageUniqueID, (int)s.length(), s.data());
 					}
 				}
 			}
-		}; // class Task
+			results = std::move(parsed);
+		};
 
 
 		data.packagesByName.reserve(1500);
 		data.packagesByProvides.reserve(2500);
-		data.packagesByFilePath1.reserve(370000);
 
-		std::vector<std::unique_ptr<ThreadPool::Task>> tasks;
-		tasks.reserve(1500);
-		iterateInstalledPackages([&](std::string installedPackageUniqueID) {
-			tasks.push_back(std::make_unique<Task>(*this, std::move(installedPackageUniqueID)));
-		});
-		ctx.threadPool.addTasks(ctx.threadPool.groupTasks(std::move(tasks)));
+		std::vector<std::string> installedPackageUniqueIDs;
+		installedPackageUniqueIDs.reserve(1500);
+		if (trustCache) {
+			for (auto& [uniqueID, _] : cache.getRecordsByUniqueID()) {
+				installedPackageUniqueIDs.push_back(std::string(uniqueID));
+			}
+		} else {
+			iterateInstalledPackages([&](std::string installedPackageUniqueID) {
+				installedPackageUniqueIDs.push_back(std::move(installedPackageUniqueID));
+			});
+		}
+		ctx.threadPool.parallelReduce<std::vector<parseInstalledPackage_Result>>(std::span(installedPackageUniqueIDs), parseOne, combineParsed, mergeParsed);
 		ctx.threadPool.waitAll();
 
+		// Taken before config file edits package's optDepends.
+		auto toCacheEntry = [](const parseInstalledPackage_Result& r) {
+			InstalledPackagesCache::Entry e;
+			e.uniqueID = r.installedPackageUniqueID;
+			e.mtime = r.mtime;
+			e.name = r.p->name.sv();
+			e.version = r.p->version.sv();
+			for (auto& s : r.p->provides) {
+				e.provides.push_back(s.sv());
+			}
+			for (auto& s : r.p->optDepends) {
+				e.optDepends.push_back(s.sv());
+			}
+			e.filePaths1 = r.filePaths1;
+			return e;
+		};
+
+		if (ctx.lazyOwnership) {
+			// File lists were not read, so there's nothing to merge. Cache is saved by assignUnresolvedFiles() if it reads file lists.
+			installedPackages.reserve(results.size());
+			for (auto& r : results) {
+				installedPackages.push_back({
+					.p = r.p, .uniqueID = r.installedPackageUniqueID,
+					.cacheEntry = r.isFromCache ? InstalledPackagesCache::Entry{} : toCacheEntry(r), .isFromCache = r.isFromCache
+				});
+			}
+			if (ctx.verbosity >= Verbosity_Debug) {
+				size_t numFromCache = std::count_if(results.begin(), results.end(), [](auto& r) { return r.isFromCache; });
+				ctx.log.debug(FILE_LINE "stats: installed packages: %lu from cache, %lu parsed without files", ulong{numFromCache}, ulong{results.size() - numFromCache});
+				ctx.log.debug(FILE_LINE "stats: data.packagesByName.size() = %lu", ulong{data.packagesByName.size()});
+				ctx.log.debug(FILE_LINE "stats: data.packagesByProvides.size() = %lu", ulong{data.packagesByProvides.size()});
+			}
+			return;
+		}
+
+
+		// Update cache if anything changed.
+		// ---------------------------------
+		{
+			size_t numFromCache = std::count_if(results.begin(), results.end(), [](auto& r) { return r.isFromCache; });
+			if (ctx.verbosity >= Verbosity_Debug) {
+				ctx.log.debug(FILE_LINE "stats: installed packages: %lu from cache, %lu parsed", ulong{numFromCache}, ulong{results.size() - numFromCache});
+			}
+			if (!trustCache || numFromCache != results.size()) {
+				std::vector<InstalledPackagesCache::Entry> entries;
+				entries.reserve(results.size());
+				for (auto& r : results) {
+					entries.push_back(toCacheEntry(r));
+				}
+				saveInstalledPackagesCache(entries);
+			}
+		}
+
+
+		buildPackagesByFilePath1(results);
+		cache.unload();
+
 		if (ctx.verbosity >= Verbosity_Debug) {
 			ctx.log.debug(FILE_LINE "stats: data.packagesByName.size() = %lu", ulong{data.packagesByName.size()});
 			ctx.log.debug(FILE_LINE "stats: data.packagesByProvides.size() = %lu", ulong{data.packagesByProvides.size()});
 			ctx.log.debug(FILE_LINE "stats: data.packagesByFilePath1.size() = %lu", ulong{data.packagesByFilePath1.size()});
+			ctx.log.debug(FILE_LINE "stats: data.packagesByFilePath1.memoryUsage() = %lu", ulong{data.packagesByFilePath1.memoryUsage()});
 		}
 	} // PacMan::parseInstalledPackages()
 
@@ -122,6 +266,329 @@ namespace dimgel {
 	//----------------------------------------------------------------------------------------------------------------------------------------
 
 
+	// Key space is split into ranges by splitters sampled from all lists; each range is k-way merged by separate task into its own map,
+	// then maps are concatenated. Equal paths always fall into same range, so duplicate owners are still detected.
+	void PacMan::buildPackagesByFilePath1(const std::vector<parseInstalledPackage_Result>& results) {
+		size_t numPaths = 0;
+		std::vector<std::string_view> splitters;
+		for (auto& r : results) {
+			numPaths += r.filePaths1.size();
+			for (size_t i = 0;  i < r.filePaths1.size();  i += 64) {
+				splitters.push_back(r.filePaths1[i]);
+			}
+		}
+		size_t numShards = std::min(numPaths / 4096 + 1, size_t{64});
+		std::sort(splitters.begin(), splitters.end());
+		{
+			std::vector<std::string_view> ss;
+			ss.reserve(numShards - 1);
+			for (size_t i = 1;  i < numShards;  i++) {
+				ss.push_back(splitters[i * splitters.size() / numShards]);
+			}
+			ss.erase(std::unique(ss.begin(), ss.end()), ss.end());
+			splitters = std::move(ss);
+		}
+		numShards = splitters.size() + 1;
+
+		class ShardTask : public ThreadPool::Task {
+			const std::vector<parseInstalledPackage_Result>& results;
+			// Range [lo, hi); empty lo means -inf, null hi means +inf.
+			std::string_view lo;
+			const std::string_view* hi;
+			FrontCodedStringMap<Package*>& target;
+
+		public:
+			ShardTask(const std::vector<parseInstalledPackage_Result>& results, std::string_view lo, const std::string_view* hi, FrontCodedStringMap<Package*>& target)
+				: results(results), lo(lo), hi(hi), target(target)
+			{
+			}
+
+			void compute() override {
+				struct Cursor {
+					std::string_view path1;
+					uint32_t iResult;
+					uint32_t iPath;
+					uint32_t iEnd;
+				};
+				auto greater = [](const Cursor& a, const Cursor& b) { return a.path1 > b.path1; };
+				std::vector<Cursor> heapStorage;
+				heapStorage.reserve(results.size());
+
+				size_t numPaths = 0;
+				for (uint32_t i = 0;  i < results.size();  i++) {
+					auto& v = results[i].filePaths1;
+					auto begin = std::lower_bound(v.begin(), v.end(), lo);
+					auto end = hi == nullptr ? v.end() : std::lower_bound(begin, v.end(), *hi);
+					if (begin != end) {
+						heapStorage.push_back({*begin, i, (uint32_t)(begin - v.begin()), (uint32_t)(end - v.begin())});
+						numPaths += end - begin;
+					}
+				}
+				std::priority_queue<Cursor, std::vector<Cursor>, decltype(greater)> heap(greater, std::move(heapStorage));
+
+				FrontCodedStringMap<Package*>::Builder b;
+				// Paths in same directory share most of their bytes, 16 bytes per path is generous.
+				b.reserve(numPaths, numPaths * 16);
+				std::string_view prevPath1;
+				Package* prevP = nullptr;
+				while (!heap.empty()) {
+					Cursor c = heap.top();
+					heap.pop();
+					auto& r = results[c.iResult];
+					if (prevP != nullptr && prevPath1 == c.path1) {
+						// This was a warning once, but from pacman's point of view it's error.
+						// Don't know if `pacman -Qkk` checks for it, won't be bad to fail-fast here anyway.
+						throw Error(
+							FILE_LINE "package `%s %s`: another installed package already owns file `%.*s`: `%s %s`",
+							r.p->name.cp(), r.p->version.cp(), (int)c.path1.length(), c.path1.data(), prevP->name.cp(), prevP->version.cp()
+						);
+					}
+					b.add(c.path1, r.p);
+					prevPath1 = c.path1;
+					prevP = r.p;
+					if (++c.iPath < c.iEnd) {
+						c.path1 = r.filePaths1[c.iPath];
+						heap.push(c);
+					}
+				}
+				target = b.build();
+			}
+		};
+
+		// Each task writes only to its own element, so merge() is not needed.
+		std::vector<FrontCodedStringMap<Package*>> parts(numShards);
+		std::vector<std::unique_ptr<ThreadPool::Task>> shardTasks;
+		shardTasks.reserve(numShards);
+		for (size_t i = 0;  i < numShards;  i++) {
+			shardTasks.push_back(std::make_unique<ShardTask>(
+				results, i == 0 ? std::string_view() : splitters[i - 1], i + 1 < numShards ? &splitters[i] : nullptr, parts[i]
+			));
+		}
+		ctx.threadPool.addTasks(std::move(shardTasks));
+		ctx.threadPool.waitAll();
+		data.packagesByFilePath1 = FrontCodedStringMap<Package*>::concat(std::move(parts));
+
+		if (ctx.verbosity >= Verbosity_Debug) {
+			ctx.log.debug(FILE_LINE "stats: data.packagesByFilePath1: merged in %lu shards", ulong{numShards});
+		}
+	}
+
+
+	//----------------------------------------------------------------------------------------------------------------------------------------
+
+
+	void PacMan::saveInstalledPackagesCache(const std::vector<InstalledPackagesCache::Entry>& entries) {
+		try {
+			InstalledPackagesCache::save(getInstalledPackagesCachePath(), installedPackagesRootMTime, entries);
+		} catch (std::exception& e) {
+			// E.g. not running as root. Not fatal: it's only cache.
+			if (ctx.verbosity >= Verbosity_WarnAndExec) {
+				ctx.log.warn(FILE_LINE "could not save installed packages cache: %s", e.what());
+			}
+		}
+	}
+
+
+	void PacMan::readInstalledPackageFiles(const InstalledPackage& ip, parseInstalledPackage_Result& r) {
+		InstalledPackagesCache::Entry e;
+		if (ip.isFromCache && installedPackagesCache.get(ip.uniqueID, e)) {
+			r.filePaths1 = std::move(e.filePaths1);
+		} else {
+			parseInstalledPackageFiles(ip.uniqueID, r);
+			std::sort(r.filePaths1.begin(), r.filePaths1.end());
+		}
+	}
+
+
+	void PacMan::loadInstalledPackagesFiles(const std::vector<Package*>& packages) {
+		if (!ctx.lazyOwnership || packages.empty()) {
+			return;
+		}
+
+		std::unordered_set<Package*> packagesSet(packages.begin(), packages.end());
+		std::vector<parseInstalledPackage_Result> results;
+		std::vector<InstalledPackage*> ips;   // Parallel to `results`.
+		results.reserve(packages.size());
+		ips.reserve(packages.size());
+		for (auto& ip : installedPackages) {
+			if (packagesSet.contains(ip.p)) {
+				results.emplace_back().p = ip.p;
+				ips.push_back(&ip);
+			}
+		}
+		using Loaded = std::vector<InstalledPackage*>;
+		ctx.threadPool.parallelFor<Loaded>(
+			std::span(results),
+			[&](Loaded& loaded, parseInstalledPackage_Result& r) {
+				InstalledPackage* ip = ips[&r - results.data()];
+				readInstalledPackageFiles(*ip, r);
+				loaded.push_back(ip);
+			},
+			[](Loaded& loaded) {
+				for (InstalledPackage* ip : loaded) {
+					ip->isFilesLoaded = true;
+				}
+			}
+		);
+		ctx.threadPool.waitAll();
+		buildPackagesByFilePath1(results);
+
+		if (ctx.verbosity >= Verbosity_Debug) {
+			ctx.log.debug(FILE_LINE "stats: lazy ownership: loaded files of %lu package(s) referenced by config", ulong{results.size()});
+			ctx.log.debug(FILE_LINE "stats: data.packagesByFilePath1.size() = %lu", ulong{data.packagesByFilePath1.size()});
+		}
+	}
+
+
+	void PacMan::assignUnresolvedFiles() {
+		if (!ctx.lazyOwnership) {
+			return;
+		}
+
+		// Files left unresolved by Resolver which are still unassigned: either not owned by any package, or owned by package not referenced by config.
+		std::vector<File*> files;
+		for (auto& [_, f] : data.uniqueFilesByPath1) {
+			if (f->belongsToPackage == nullptr && !f->neededLibs.empty()) {
+				files.push_back(f);
+			}
+		}
+		if (files.empty()) {
+			return;
+		}
+
+		auto assign = [&](File* f, Package* p) {
+			if (Package* p0 = f->belongsToPackage) {
+				throw Error(
+					FILE_LINE "package `%s %s`: another installed package already owns file `%s`: `%s %s`",
+					p->name.cp(), p->version.cp(), f->path1.cp(), p0->name.cp(), p0->version.cp()
+				);
+			}
+			f->belongsToPackage = p;
+			if (ctx.verbosity >= Verbosity_Debug) {
+				ctx.log.debug(FILE_LINE "`/%s`: assign package `%s %s`", f->path1.cp(), p->name.cp(), p->version.cp());
+			}
+		};
+
+		// 1. Packages with valid cache entries: look up each file in cache's path index, without reading any file list.
+		//    Files of already loaded packages were assigned by FilesCollector.
+		std::unordered_map<std::string_view, const InstalledPackage*> cachedPackagesByUniqueID;
+		for (auto& ip : installedPackages) {
+			if (ip.isFromCache && !ip.isFilesLoaded) {
+				cachedPackagesByUniqueID.insert({ip.uniqueID, &ip});
+			}
+		}
+		if (!cachedPackagesByUniqueID.empty()) {
+			using Found = std::vector<std::pair<File*, Package*>>;
+			ctx.threadPool.parallelFor<Found>(
+				std::span(files),
+				[&](Found& found, File* f) {
+					std::vector<std::string_view> uniqueIDs;
+					installedPackagesCache.findOwners(f->path1.sv(), uniqueIDs);
+					for (auto id : uniqueIDs) {
+						// Entries of packages changed since cache was saved are not trusted: those packages are searched below.
+						if (auto it = cachedPackagesByUniqueID.find(id);  it != cachedPackagesByUniqueID.end()) {
+							found.push_back({f, it->second->p});
+						}
+					}
+				},
+				[&](Found& found) {
+					for (auto [f, p] : found) {
+						assign(f, p);
+					}
+				}
+			);
+			ctx.threadPool.waitAll();
+		}
+
+		// 2. Packages not in cache (installed or upgraded since it was saved): read their file lists and binary-search each file in them.
+		//    Cache is saved then, so next run gets them from step 1. Lists of packages loaded by loadInstalledPackagesFiles() are read too,
+		//    for cache to be complete; but their files were assigned by FilesCollector.
+		struct UncachedPackage {
+			const InstalledPackage* ip;
+			parseInstalledPackage_Result r;
+		};
+		std::vector<UncachedPackage> uncachedPackages;
+		for (auto& ip : installedPackages) {
+			if (!ip.isFromCache) {
+				uncachedPackages.push_back({.ip = &ip, .r = {}});
+			}
+		}
+		if (!uncachedPackages.empty()) {
+			using Found = std::vector<std::pair<File*, Package*>>;
+			ctx.threadPool.parallelFor<Found>(
+				std::span(uncachedPackages),
+				[&](Found& found, UncachedPackage& u) {
+					readInstalledPackageFiles(*u.ip, u.r);
+					if (u.ip->isFilesLoaded) {
+						return;
+					}
+					for (File* f : files) {
+						if (std::binary_search(u.r.filePaths1.begin(), u.r.filePaths1.end(), f->path1.sv())) {
+							found.push_back({f, u.ip->p});
+						}
+					}
+				},
+				[&](Found& found) {
+					for (auto [f, p] : found) {
+						assign(f, p);
+					}
+				}
+			);
+			ctx.threadPool.waitAll();
+
+			std::vector<InstalledPackagesCache::Entry> entries;
+			entries.reserve(installedPackages.size());
+			for (auto& ip : installedPackages) {
+				if (ip.isFromCache) {
+					installedPackagesCache.get(ip.uniqueID, entries.emplace_back());
+				}
+			}
+			for (auto& u : uncachedPackages) {
+				auto& e = entries.emplace_back(u.ip->cacheEntry);
+				e.uniqueID = u.ip->uniqueID;
+				e.filePaths1 = u.r.filePaths1;
+			}
+			saveInstalledPackagesCache(entries);
+		}
+
+		if (ctx.verbosity >= Verbosity_Debug) {
+			ctx.log.debug(
+				FILE_LINE "stats: lazy ownership: searched %lu unresolved file(s) in path index of %lu cached package(s) and in file lists of %lu other package(s)",
+				ulong{files.size()}, ulong{cachedPackagesByUniqueID.size()}, ulong{uncachedPackages.size()}
+			);
+		}
+	}
+
+
+	//----------------------------------------------------------------------------------------------------------------------------------------
+
+
+	bool PacMan::parseSonameProvides(std::string_view provides, std::string& soname, bool& is32) {
+		auto iEq = provides.find('=');
+		if (iEq == std::string_view::npos || !provides.substr(0, iEq).ends_with(".so")) {
+			return false;
+		}
+		auto name = provides.substr(0, iEq);
+		auto verAndBits = provides.substr(iEq + 1);
+		auto iDash = verAndBits.rfind('-');
+		if (iDash == std::string_view::npos) {
+			return false;
+		}
+		auto bits = verAndBits.substr(iDash + 1);
+		if (bits != "64" && bits != "32") {
+			return false;
+		}
+		is32 = bits == "32";
+		// Unversioned soname has empty version: "libfoo.so=-64".
+		auto ver = verAndBits.substr(0, iDash);
+		soname.assign(name);
+		if (!ver.empty()) {
+			soname.append(".").append(ver);
+		}
+		return true;
+	}
+
+
 	void PacMan::calculateOptionalDependencies() {
 		for (auto& [_, f] : data.uniqueFilesByPath1) {
 			if (f->belongsToPackage == nullptr) {
@@ -141,6 +608,10 @@ namespace dimgel {
 			}
 		}
 
+		if (!data.archiveNamesByOptDepend.empty()) {
+			filterOptionalDependenciesBySyncDatabases();
+		}
+
 		data.optDependsSorted.reserve(data.archiveNamesByOptDepend.size());
 		for (auto& [od, _] : data.archiveNamesByOptDepend) {
 			data.optDependsSorted.push_back(od);
@@ -149,29 +620,240 @@ namespace dimgel {
 	}
 
 
-	//----------------------------------------------------------------------------------------------------------------------------------------
+	// Sync databases declare sonames in `provides`, so for problematic file whose unresolved libs are ALL declared by some repository package,
+	// only those optdepends of its package which declare at least one of them can help. If any unresolved lib is not declared anywhere
+	// (package does not list it in PKGBUILD's `provides`, or it's absolute path), all optdepends are kept: nothing is known about them.
+	//
+	// If ALL repositories have `.files` databases, knowledge is complete: optdepend is kept only if it declares needed soname, or contains
+	// file with needed name (or absolute path). Only such archives are downloaded, to confirm bitness and ELF type; if there are none,
+	// nothing is downloaded at all.
+	void PacMan::filterOptionalDependenciesBySyncDatabases() {
+		auto dbs = getSyncDatabases();
+		if (dbs.empty()) {
+			if (ctx.verbosity >= Verbosity_Debug) {
+				ctx.log.debug(FILE_LINE "no sync databases, keeping all optional dependencies");
+			}
+			return;
+		}
+		bool allHaveFiles = std::all_of(dbs.begin(), dbs.end(), [](auto& db) { return db.hasFiles; });
+
+		// Only unresolved names are collected, and only for packages which are candidate optdepends (by name or by `provides`).
+		// Strings reuse keys of data.unresolvedNeededLibNames and data.archiveNamesByOptDepend, so nothing is allocated.
+		struct Index {
+			std::unordered_set<PathAndBitnessKey> declaredSonames;
+			alloc::StringHashMap<std::vector<PathAndBitnessKey>> sonamesByOptDepend;
+			// Any bitness: file name says nothing about it.
+			alloc::StringHashMap<std::vector<alloc::String>> containedLibsByOptDepend;
+			// Moved to PacMan members only if all databases are parsed: partial data would make findSyncArchive() see single provider
+			// where there are several, or miss same package in different repositories.
+			alloc::StringHashMap<std::vector<alloc::String>> syncPackageNamesByOptDepend;
+			alloc::StringHashMap<SyncArchive> syncArchivesByPackageName;
+		} index;
+
+		class Task : public ThreadPool::Task {
+			PacMan& owner;
+			const SyncDatabase& db;
+			Index& index;
+			std::vector<PathAndBitnessKey> declared;
+			std::vector<std::pair<alloc::String, PathAndBitnessKey>> supplied;
+			std::vector<std::pair<alloc::String, alloc::String>> contained;
+			std::vector<std::pair<alloc::String, std::string>> providers;
+			struct Archive {
+				std::string packageName;
+				std::string archiveName;
+				uint64_t size;
+				std::string sha256;
+			};
+			std::vector<Archive> archives;
 
+		public:
+			Task(PacMan& owner, const SyncDatabase& db, Index& index)
+				: owner(owner), db(db), index(index)
+			{
+			}
 
-	// data.unresolvedNeededLibsByName contains either name not containing '/', or absolute path starting with '/'.
-	// Both ways, I got exhaustive list of what I'm looking for, so I don't need to check for "*.so*" name pattern here.
-	bool PacMan::ParseArchiveTask::onFileIsNeeded_impl(StringRef filePath1) {
-		auto fileName = filePath1;
-		auto lastSlash = fileName.rfind('/');
-		if (lastSlash != fileName.npos) {
-			fileName.remove_prefix(lastSlash + 1);
+			void compute() override {
+				auto& unresolved = owner.data.unresolvedNeededLibNames;
+				auto& candidates = owner.data.archiveNamesByOptDepend;
+				std::vector<PathAndBitnessKey> sonames;
+				std::vector<alloc::String> libs;
+				std::string buf;
+				bool is32;
+				try {
+					owner.parseSyncDatabase(db, [&](const SyncPackage& sp) {
+						sonames.clear();
+						for (auto pr : sp.provides) {
+							if (parseSonameProvides(pr, buf, is32)) {
+								if (auto it = unresolved.find(buf);  it != unresolved.end()) {
+									sonames.push_back({.path1 = *it, .is32 = is32});
+								}
+							}
+						}
+						libs.clear();
+						for (auto fp : sp.filePaths1) {
+							if (auto nl = owner.findUnresolvedNeededLib(fp)) {
+								libs.push_back(*nl);
+							}
+						}
+						declared.insert(declared.end(), sonames.begin(), sonames.end());
+
+						bool isProvider = false;
+						auto add = [&](std::string_view od) {
+							if (auto it = candidates.find(od);  it != candidates.end()) {
+								isProvider = true;
+								providers.push_back({it->first, std::string(sp.name)});
+								for (auto& s : sonames) {
+									supplied.push_back({it->first, s});
+								}
+								for (auto& l : libs) {
+									contained.push_back({it->first, l});
+								}
+							}
+						};
+						add(sp.name);
+						for (auto pr : sp.provides) {
+							// Optdepend may be either bare name, or exactly same string as in `provides`, e.g. "libfoo.so=1-64".
+							auto name = pr.substr(0, pr.find_first_of("<>="));
+							add(name);
+							if (name.length() != pr.length()) {
+								add(pr);
+							}
+						}
+						if (isProvider && !sp.archiveName.empty() && !sp.archiveSHA256.empty()) {
+							archives.push_back({std::string(sp.name), std::string(sp.archiveName), sp.archiveSize, std::string(sp.archiveSHA256)});
+						}
+					});
+				} catch (std::exception& e) {
+					// Incomplete data would make filter drop needed optdepends; waitAll() will throw Abort then.
+					if (owner.ctx.verbosity >= Verbosity_WarnAndExec) {
+						owner.ctx.log.warn(FILE_LINE "ignoring sync databases: %s", e.what());
+					}
+					throw Abort();
+				}
+			}
+
+			void merge() override {
+				index.declaredSonames.insert(declared.begin(), declared.end());
+				for (auto& [od, s] : supplied) {
+					index.sonamesByOptDepend[od].push_back(s);
+				}
+				for (auto& [od, name] : providers) {
+					index.syncPackageNamesByOptDepend[od].push_back(alloc::String{owner.ctx.mm, name});
+				}
+				for (auto& a : archives) {
+					if (auto it = index.syncArchivesByPackageName.find(a.packageName);  it != index.syncArchivesByPackageName.end()) {
+						if (it->second.archiveName.sv() != std::string_view(a.archiveName)) {
+							// Same package in different repositories (e.g. `core` and `core-testing`): don't guess which one pacman would choose.
+							it->second.sha256 = {};
+						}
+						continue;
+					}
+					index.syncArchivesByPackageName.insert({
+						alloc::String{owner.ctx.mm, a.packageName},
+						{.archiveName = alloc::String{owner.ctx.mm, a.archiveName}, .size = a.size, .sha256 = alloc::String{owner.ctx.mm, a.sha256}}
+					});
+				}
+				for (auto& [od, l] : contained) {
+					if (owner.ctx.verbosity >= Verbosity_Debug) {
+						owner.ctx.log.debug(FILE_LINE "read `%s`: optional dependency `%s` contains `%s`", db.path.c_str(), od.cp(), l.cp());
+					}
+					index.containedLibsByOptDepend[od].push_back(l);
+				}
+			}
+		};
+
+		std::vector<std::unique_ptr<ThreadPool::Task>> tasks;
+		tasks.reserve(dbs.size());
+		for (auto& db : dbs) {
+			tasks.push_back(std::make_unique<Task>(*this, db, index));
 		}
-		if (owner.data.unresolvedNeededLibNames.contains(fileName)) {
-			return true;
+		ctx.threadPool.addTasks(std::move(tasks));
+		try {
+			ctx.threadPool.waitAll();
+		} catch (Abort&) {
+			return;
 		}
+		syncPackageNamesByOptDepend = std::move(index.syncPackageNamesByOptDepend);
+		syncArchivesByPackageName = std::move(index.syncArchivesByPackageName);
+
+		auto canSupply = [&](const alloc::String& optdep, File* f) {
+			if (auto it = index.sonamesByOptDepend.find(optdep);  it != index.sonamesByOptDepend.end()) {
+				for (auto& s : it->second) {
+					if (s.is32 == f->is32 && f->neededLibs.contains(s.path1)) {
+						return true;
+					}
+				}
+			}
+			if (auto it = index.containedLibsByOptDepend.find(optdep);  it != index.containedLibsByOptDepend.end()) {
+				for (auto& l : it->second) {
+					if (f->neededLibs.contains(l)) {
+						return true;
+					}
+				}
+			}
+			return false;
+		};
 
-		char filePath0[PATH_MAX];
-		filePath0[0] = '/';
-		strcpy(filePath0 + 1, filePath1.cp());
-		if (owner.data.unresolvedNeededLibNames.contains(filePath0)) {
-			return true;
+		alloc::StringHashSet needed;
+		for (auto& [_, f] : data.uniqueFilesByPath1) {
+			Package* p = f->belongsToPackage;
+			if (p == nullptr) {
+				continue;
+			}
+			bool isKnown = allHaveFiles || std::all_of(f->neededLibs.begin(), f->neededLibs.end(), [&](const alloc::String& nl) {
+				return index.declaredSonames.contains({.path1 = nl, .is32 = f->is32});
+			});
+			for (auto& optdep : p->optDepends) {
+				if (data.archiveNamesByOptDepend.contains(optdep) && !needed.contains(optdep) && (!isKnown || canSupply(optdep, f))) {
+					needed.insert(optdep);
+				}
+			}
+		}
+
+		for (auto it = data.archiveNamesByOptDepend.begin();  it != data.archiveNamesByOptDepend.end();  ) {
+			if (needed.contains(it->first)) {
+				++it;
+			} else {
+				if (ctx.verbosity >= Verbosity_Debug) {
+					ctx.log.debug(FILE_LINE "skip optional dependency `%s`: sync databases say it provides none of needed libs", it->first.cp());
+				}
+				it = data.archiveNamesByOptDepend.erase(it);
+			}
+		}
+		if (ctx.verbosity >= Verbosity_Debug) {
+			ctx.log.debug(
+				FILE_LINE "stats: sync databases: %lu of %lu with file lists, %lu declared unresolved soname(s), %lu optional dependencies left",
+				ulong{(size_t)std::count_if(dbs.begin(), dbs.end(), [](auto& db) { return db.hasFiles; })}, ulong{dbs.size()},
+				ulong{index.declaredSonames.size()}, ulong{data.archiveNamesByOptDepend.size()}
+			);
 		}
+	}
+
+
+	//----------------------------------------------------------------------------------------------------------------------------------------
+
+
+	const alloc::String* PacMan::findUnresolvedNeededLib(std::string_view filePath1) const {
+		// data.unresolvedNeededLibNames contains either name not containing '/', or absolute path starting with '/'.
+		// Both ways, I got exhaustive list of what I'm looking for, so I don't need to check for "*.so*" name pattern here.
+		// rfind() returns npos if there's no '/', and npos + 1 == 0.
+		auto fileName = filePath1.substr(filePath1.rfind('/') + 1);
+		if (data.unresolvedNeededLibNamesFilter.mayContain(fileName)) {
+			if (auto it = data.unresolvedNeededLibNames.find(fileName);  it != data.unresolvedNeededLibNames.end()) {
+				return &*it;
+			}
+		}
+		if (!data.unresolvedNeededLibNamesByPath1.empty()) {
+			if (auto it = data.unresolvedNeededLibNamesByPath1.find(filePath1);  it != data.unresolvedNeededLibNamesByPath1.end()) {
+				return &it->second;
+			}
+		}
+		return nullptr;
+	}
 
-		return false;
+
+	bool PacMan::ParseArchiveTask::onFileIsNeeded_impl(StringRef filePath1) {
+		return owner.findUnresolvedNeededLib(filePath1.sv()) != nullptr;
 	};
 
 
@@ -182,6 +864,9 @@ namespace dimgel {
 		if (resolvedPath == nullptr || resolvedPath[0] == '\0') {
 			return;
 		}
+		if (!isReplaying) {
+			recordedSymlinks.push_back({alloc::String{owner.ctx.mm, symlinkPath1}.sv(), alloc::String{owner.ctx.mm, resolvedPath}.sv()});
+		}
 
 		if (onFileIsNeeded_impl(StringRef{symlinkPath1})) {
 			neededSymlinks.insert(alloc::String{owner.ctx.mm, symlinkPath1});
@@ -243,6 +928,10 @@ namespace dimgel {
 
 	bool PacMan::ParseArchiveTask::onFileIsNeeded(const char* filePath1) {
 		StringRef sr(filePath1);
+		// May be recorded twice (e.g. from `.MTREE` and then from payload), deduplicated by fillNewEntry().
+		if (!isReplaying && isOwnedFileRelevant(sr.sv())) {
+			recordedFilePaths1.push_back(alloc::String{owner.ctx.mm, sr}.sv());
+		}
 		return neededSymlinksByFilePath1.contains(sr) || onFileIsNeeded_impl(sr);
 	}
 
@@ -258,9 +947,19 @@ namespace dimgel {
 		File* f = File::create(owner.ctx.mm);
 		f->path1 = alloc::String{owner.ctx.mm, filePath1};   // elfInspector uses this to show messages.
 		owner.elfInspector.processOne_fromArchive(*f, buf, size);
+		recordedInspectedFiles.push_back({.path1 = f->path1.sv(), .isDynamicELF = f->isDynamicELF, .isLib = f->isLib, .is32 = f->is32});
+		onFileInspected(f);
+	}
+
+
+	//----------------------------------------------------------------------------------------------------------------------------------------
+
+
+	// Resolver needs only these File fields from optdepends' libs, so they are all that OptDependsArchivesCache keeps.
+	void PacMan::ParseArchiveTask::onFileInspected(File* f) {
 		if (!f->isLib) {
 			if (owner.ctx.verbosity >= Verbosity_WarnAndExec) {
-				owner.ctx.log.warn(FILE_LINE "read `%s`: neededFile.notLibrary `/%s`", archiveName.cp(), filePath1);
+				owner.ctx.log.warn(FILE_LINE "read `%s`: neededFile.notLibrary `/%s`", archiveName.cp(), f->path1.cp());
 			}
 			return;
 		}
@@ -295,12 +994,122 @@ namespace dimgel {
 	//----------------------------------------------------------------------------------------------------------------------------------------
 
 
+	void PacMan::ParseArchiveTask::lookupCache() {
+		isArchiveFound = owner.statArchive(archiveName.sv(), archiveSize, archiveMTime);
+		if (!isArchiveFound) {
+			archiveSize = 0;
+		}
+		OptDependsArchivesCache::Entry e;
+		if (owner.optDependsArchivesCache.get(archiveName.sv(), e) && (!isArchiveFound || (e.size == archiveSize && e.mtime == archiveMTime))) {
+			cachedEntry = std::move(e);
+		}
+	}
+
+
+	//----------------------------------------------------------------------------------------------------------------------------------------
+
+
+	bool PacMan::ParseArchiveTask::replayCache() {
+		auto& e = *cachedEntry;
+		isReplaying = true;
+		for (auto& [path1, target] : e.symlinks) {
+			onSymlink(std::string(path1).c_str(), std::string(target).c_str());
+		}
+		onSymlinksDone();
+
+		std::vector<const OptDependsArchivesCache::InspectedFile*> neededFiles;
+		for (auto path1 : e.filePaths1) {
+			if (onFileIsNeeded(std::string(path1).c_str())) {
+				auto f = e.findInspectedFile(path1);
+				if (f == nullptr) {
+					if (owner.ctx.verbosity >= Verbosity_Debug) {
+						owner.ctx.log.debug(FILE_LINE "read `%s`: cached entry lacks needed file `/%.*s`", archiveName.cp(), (int)path1.length(), path1.data());
+					}
+					neededSymlinksByFilePath1.clear();
+					isReplaying = false;
+					return false;
+				}
+				neededFiles.push_back(f);
+			}
+		}
+
+		auto& mm = owner.ctx.mm;
+		p->name = alloc::String{mm, e.name};
+		p->version = alloc::String{mm, e.version};
+		for (auto s : e.provides) {
+			p->provides.insert(alloc::String{mm, s});
+		}
+		for (auto cf : neededFiles) {
+			if (owner.ctx.verbosity >= Verbosity_Debug) {
+				owner.ctx.log.debug(FILE_LINE "read `%s`: neededFile.fromCache `/%.*s`", archiveName.cp(), (int)cf->path1.length(), cf->path1.data());
+			}
+			File* f = File::create(mm);
+			f->path1 = alloc::String{mm, cf->path1};
+			f->isDynamicELF = cf->isDynamicELF;
+			f->isLib = cf->isLib;
+			f->is32 = cf->is32;
+			onFileInspected(f);
+		}
+		isReplaying = false;
+		return true;
+	}
+
+
+	//----------------------------------------------------------------------------------------------------------------------------------------
+
+
+	// Called after successful impl(). If cached entry for same archive existed but was not enough, its ELF summaries are kept too.
+	void PacMan::ParseArchiveTask::fillNewEntry() {
+		auto& e = newEntry;
+		e.archiveName = archiveName.sv();
+		e.size = archiveSize;
+		e.mtime = archiveMTime;
+		e.name = p->name.sv();
+		e.version = p->version.sv();
+		for (auto& s : p->provides) {
+			e.provides.push_back(s.sv());
+		}
+		e.symlinks = std::move(recordedSymlinks);
+
+		std::sort(recordedFilePaths1.begin(), recordedFilePaths1.end());
+		recordedFilePaths1.erase(std::unique(recordedFilePaths1.begin(), recordedFilePaths1.end()), recordedFilePaths1.end());
+		e.filePaths1 = std::move(recordedFilePaths1);
+
+		auto byPath1 = [](auto& a, auto& b) { return a.path1 < b.path1; };
+		std::sort(recordedInspectedFiles.begin(), recordedInspectedFiles.end(), byPath1);
+		if (cachedEntry) {
+			for (auto& f : cachedEntry->inspectedFiles) {
+				if (!std::binary_search(recordedInspectedFiles.begin(), recordedInspectedFiles.end(), f, byPath1)) {
+					recordedInspectedFiles.push_back(f);
+				}
+			}
+			std::sort(recordedInspectedFiles.begin(), recordedInspectedFiles.end(), byPath1);
+		}
+		e.inspectedFiles = std::move(recordedInspectedFiles);
+	}
+
+
+	//----------------------------------------------------------------------------------------------------------------------------------------
+
+
 	void PacMan::ParseArchiveTask::compute() {
+		auto startTime = std::chrono::steady_clock::now();
 		p = Package::create(owner.ctx.mm);
 		p->archiveName = archiveName;
 
 		try {
-			impl(p);
+			if (cachedEntry && replayCache()) {
+				isFromCache = true;
+			} else if (cachedEntry && !isArchiveFound) {
+				// Archive was removed from package manager's cache; processOptionalDependencies() will download it and re-run me.
+				if (owner.ctx.verbosity >= Verbosity_Debug) {
+					owner.ctx.log.debug(FILE_LINE "read `%s`: archive is missing and cached entry is not enough", archiveName.cp());
+				}
+				isArchiveNeeded = true;
+				throw Abort();
+			} else {
+				impl(p);
+			}
 			if (p->name.empty()) {
 				if (owner.ctx.verbosity >= Verbosity_WarnAndExec) {
 					owner.ctx.log.warn(FILE_LINE "ignore `%s`: empty package name", archiveName.cp());
@@ -330,6 +1139,10 @@ namespace dimgel {
 					owner.ctx.log.debug(FILE_LINE "read `%s`: provides `%s`", archiveName.cp(), s.cp());
 				}
 			}
+
+			if (!isFromCache) {
+				fillNewEntry();
+			}
 		} catch (Abort& e) {
 			p = nullptr;
 		} catch (std::exception& e) {
@@ -338,6 +1151,7 @@ namespace dimgel {
 			}
 			p = nullptr;
 		}
+		duration = std::chrono::steady_clock::now() - startTime;
 	}
 
 
@@ -345,13 +1159,23 @@ namespace dimgel {
 
 
 	void PacMan::ParseArchiveTask::merge() {
+		owner.parseArchiveTasksDuration += duration;
+		if (isArchiveNeeded) {
+			owner.optDependsWithMissingArchives.push_back(optDepName);
+		}
 		if (p == nullptr) {
 			// compute() failed.
 			return;
 		}
+		if (isFromCache) {
+			owner.optDependsArchivesCacheEntries.push_back(std::move(*cachedEntry));
+		} else {
+			owner.optDependsArchivesCacheEntries.push_back(std::move(newEntry));
+			owner.numArchivesParsed++;
+		}
 
 		for (auto [pathAndBitness, f] : libs) {
-			if (!owner.data.libs.insert({pathAndBitness, f}).second && owner.ctx.verbosity >= Verbosity_WarnAndExec) {
+			if (!owner.data.libs.insert(pathAndBitness, f).second && owner.ctx.verbosity >= Verbosity_WarnAndExec) {
 				owner.ctx.log.warn(
 					FILE_LINE "read `%s`: libs.error {`%s`, %s-bit}: duplicate key, ignoring",
 					archiveName.cp(), f->path1.cp(), (f->is32 ? "32" : "64")
@@ -371,27 +1195,163 @@ namespace dimgel {
 		if (ctx.verbosity >= Verbosity_Default) {
 			ctx.log.info("%s optional dependencies of problematic packages...", (ctx.noNetwork ? "Locating" : "Downloading"));
 		}
-		downloadOptionalDependencies_impl();
+		parseArchiveTasksDuration = {};
+		numParseArchiveTasks = 0;
+		parseArchiveTasksTotalSize = 0;
+		optDependsQueuedForParsing.clear();
+		optDependsArchivesCacheEntries.clear();
+		numArchivesParsed = 0;
+		optDependsWithMissingArchives.clear();
+		try {
+			optDependsArchivesCache.load(getOptDependsArchivesCachePath());
+		} catch (std::exception& e) {
+			if (ctx.verbosity >= Verbosity_WarnAndExec) {
+				ctx.log.warn(FILE_LINE "ignoring optional dependencies archives cache: %s", e.what());
+			}
+		}
+		// Located archives are queued for parsing while the rest are downloaded. If download fails, queued ParseArchiveTask-s
+		// must not outlive this PacMan and `data` which are destroyed while exception propagates.
+		try {
+			downloadOptionalDependencies_impl();
+		} catch (...) {
+			ctx.threadPool.cancelAll();
+			throw;
+		}
+	}
+
+
+	//----------------------------------------------------------------------------------------------------------------------------------------
+
+
+	// Tasks share nothing but thread-safe ctx.mm, ctx.log and ELFInspector (each task has its own libarchive handle and libelf descriptors),
+	// so they did run in parallel. What did not scale was scheduling: groupTasks() packed archives into one group per thread in hash order,
+	// so wall time was that of the group which happened to get several big archives. Now tasks are queued one by one, largest first:
+	// decompression time is roughly proportional to archive size, and few dozens of tasks don't make mutex contention noticeable.
+	//
+	// Called by downloadOptionalDependencies_impl() as soon as some archives are located, so that they are parsed while others are still
+	// being downloaded. Called from main thread only, between addTasks() and waitAll(): main thread only writes values
+	// of data.archiveNamesByOptDepend meanwhile, and ParseArchiveTask-s take copies of their archive names.
+	void PacMan::queueParseArchiveTasks() {
+		if (numParseArchiveTasks == 0) {
+			parseArchiveTasksStartTime = std::chrono::steady_clock::now();
+		}
+		std::vector<std::pair<uint64_t, std::unique_ptr<ParseArchiveTask>>> sizesAndTasks;
+		for (auto& [optdep, archiveName] : data.archiveNamesByOptDepend) {
+			if (!archiveName.empty() && optDependsQueuedForParsing.insert(optdep).second) {
+				auto t = createParseArchiveTask(optdep, archiveName);
+				t->lookupCache();
+				auto size = t->getArchiveSize();
+				parseArchiveTasksTotalSize += size;
+				// Replaying cached entry is cheap, whatever archive size is.
+				sizesAndTasks.push_back({t->isCached() ? 0 : size, std::move(t)});
+			}
+		};
+		std::sort(sizesAndTasks.begin(), sizesAndTasks.end(), [](auto& a, auto& b) { return a.first > b.first; });
+
+		std::vector<std::unique_ptr<ThreadPool::Task>> tasks;
+		tasks.reserve(sizesAndTasks.size());
+		for (auto& [_, t] : sizesAndTasks) {
+			tasks.push_back(std::move(t));
+		}
+		numParseArchiveTasks += tasks.size();
+		ctx.threadPool.addTasks(std::move(tasks));
 	}
 
 
 	//----------------------------------------------------------------------------------------------------------------------------------------
 
 
-	// TODO !!! Why does not work in parallel? Maybe need some wrapper around libarchive?
 	void PacMan::processOptionalDependencies() {
 		if (ctx.verbosity >= Verbosity_Default) {
 			ctx.log.info("Analyzing optional dependencies of problematic packages...");
 		}
 
-		std::vector<std::unique_ptr<ThreadPool::Task>> tasks;
-		tasks.reserve(data.archiveNamesByOptDepend.size());
-		for (auto& [optdep, archiveName] : data.archiveNamesByOptDepend) {
-			if (!archiveName.empty()) {
-				tasks.push_back(createParseArchiveTask(optdep, archiveName));
-			}
-		};
-		ctx.threadPool.addTasks(ctx.threadPool.groupTasks(std::move(tasks)));
+		// Archives located while downloads were still running are already queued or parsed; queue the rest.
+		queueParseArchiveTasks();
 		ctx.threadPool.waitAll();
+
+		// Archives which were removed from package manager's cache, and cached entries are not enough because set of needed libs changed.
+		if (!optDependsWithMissingArchives.empty()) {
+			std::vector<alloc::String> retry = std::move(optDependsWithMissingArchives);
+			optDependsWithMissingArchives.clear();
+			try {
+				downloadArchives(retry);
+			} catch (...) {
+				ctx.threadPool.cancelAll();
+				throw;
+			}
+			for (auto& optdep : retry) {
+				optDependsQueuedForParsing.erase(optdep);
+			}
+			queueParseArchiveTasks();
+			ctx.threadPool.waitAll();
+			for (auto& optdep : optDependsWithMissingArchives) {
+				if (ctx.verbosity >= Verbosity_WarnAndExec) {
+					ctx.log.warn(FILE_LINE "ignore `%s`: archive `%s` is missing", optdep.cp(), data.archiveNamesByOptDepend.at(optdep).cp());
+				}
+			}
+		}
+
+		if (ctx.verbosity >= Verbosity_Debug) {
+			auto toSeconds = [](std::chrono::steady_clock::duration d) { return std::chrono::duration<double>(d).count(); };
+			double wall = toSeconds(std::chrono::steady_clock::now() - parseArchiveTasksStartTime);
+			double sum = toSeconds(parseArchiveTasksDuration);
+			ctx.log.debug(
+				FILE_LINE "stats: processed %lu archive(s), %lu KiB total, in %.3fs since first one was queued; sum of tasks' times %.3fs, speedup x%.1f",
+				ulong{numParseArchiveTasks}, ulong{parseArchiveTasksTotalSize / 1024}, wall, sum, wall > 0 ? sum / wall : 0.0
+			);
+			ctx.log.debug(
+				FILE_LINE "stats: optional dependencies archives: %lu from cache, %lu parsed",
+				ulong{optDependsArchivesCacheEntries.size() - numArchivesParsed}, ulong{numArchivesParsed}
+			);
+		}
+
+		saveOptDependsArchivesCache();
+	}
+
+
+	//----------------------------------------------------------------------------------------------------------------------------------------
+
+
+	// Keeps entries used by this run, even if archives were removed since: that's the point of this cache. Other entries are kept only while
+	// their archives exist, so that cache does not grow forever; and they become useful again when their optdepends are needed again.
+	void PacMan::saveOptDependsArchivesCache() {
+		auto& cache = optDependsArchivesCache;
+		std::vector<OptDependsArchivesCache::Entry> entries;
+		std::unordered_set<std::string_view> archiveNames;
+		for (auto& e : optDependsArchivesCacheEntries) {
+			// Several optdepends may resolve to same archive.
+			if (archiveNames.insert(e.archiveName).second) {
+				entries.push_back(std::move(e));
+			}
+		}
+		optDependsArchivesCacheEntries.clear();
+
+		size_t numDropped = 0;
+		for (auto& [archiveName, _] : cache.getRecordsByArchiveName()) {
+			if (archiveNames.contains(archiveName)) {
+				continue;
+			}
+			OptDependsArchivesCache::Entry e;
+			uint64_t size;
+			int64_t mtime;
+			if (statArchive(archiveName, size, mtime) && cache.get(archiveName, e) && e.size == size && e.mtime == mtime) {
+				entries.push_back(std::move(e));
+			} else {
+				numDropped++;
+			}
+		}
+
+		if (numArchivesParsed != 0 || numDropped != 0) {
+			try {
+				OptDependsArchivesCache::save(getOptDependsArchivesCachePath(), entries);
+			} catch (std::exception& e) {
+				// E.g. not running as root. Not fatal: it's only cache.
+				if (ctx.verbosity >= Verbosity_WarnAndExec) {
+					ctx.log.warn(FILE_LINE "could not save optional dependencies archives cache: %s", e.what());
+				}
+			}
+		}
+		cache.unload();
 	}
 }
@@ -1,8 +1,11 @@
 #pragma once
 
+#include <chrono>
 #include <memory>
 #include <optional>
 #include "data.h"
+#include "InstalledPackagesCache.h"
+#include "OptDependsArchivesCache.h"
 #include "util/ThreadPool.h"
 
 
@@ -15,6 +18,53 @@ namespace dimgel {
 		Data& data;
 		ELFInspector& elfInspector;
 
+		// Loaded by parseInstalledPackages(). Unloaded at its end, except in lazy ownership mode: there cached file lists are searched later.
+		InstalledPackagesCache installedPackagesCache;
+		bool trustInstalledPackagesCache = false;
+		int64_t installedPackagesRootMTime = 0;
+
+		// Lazy ownership mode only (Context::lazyOwnership): all installed packages, for loadInstalledPackagesFiles() and assignUnresolvedFiles().
+		struct InstalledPackage {
+			Package* p;
+			std::string uniqueID;
+			// If !isFromCache: metadata as parsed, before config file edits, for saving cache. Fields uniqueID and filePaths1 are set on save.
+			InstalledPackagesCache::Entry cacheEntry;
+			bool isFromCache;
+			bool isFilesLoaded = false;
+		};
+		std::vector<InstalledPackage> installedPackages;
+
+		// Filled by calculateOptionalDependencies() if there are sync databases: names of packages which are (by name or by `provides`) each
+		// candidate optdepend. Used by downloadOptionalDependencies_impl() to attribute batched `pacman -Sw --print-format` output to optdepends.
+		alloc::StringHashMap<std::vector<alloc::String>> syncPackageNamesByOptDepend;
+
+		// Filled along with syncPackageNamesByOptDepend: archive of each of those packages, as declared by sync database.
+		// Used by downloadOptionalDependencies_impl() to verify already downloaded archives itself, without calling pacman for them.
+		struct SyncArchive {
+			alloc::String archiveName;
+			uint64_t size = 0;
+			alloc::String sha256;   // Lowercase hex. Empty if unusable: package has different archives in different repositories.
+		};
+		alloc::StringHashMap<SyncArchive> syncArchivesByPackageName;
+
+		// Optdepends for which ParseArchiveTask was queued by queueParseArchiveTasks().
+		alloc::StringHashSet optDependsQueuedForParsing;
+
+		// Statistics for processOptionalDependencies(): sum of ParseArchiveTask::compute() durations, to compare with wall time.
+		std::chrono::steady_clock::duration parseArchiveTasksDuration {};
+		std::chrono::steady_clock::time_point parseArchiveTasksStartTime;
+		size_t numParseArchiveTasks = 0;
+		uint64_t parseArchiveTasksTotalSize = 0;
+
+		// Loaded by downloadOptionalDependencies() (so that archives removed from package manager's cache need not be downloaded again),
+		// unloaded by processOptionalDependencies().
+		OptDependsArchivesCache optDependsArchivesCache;
+		// Filled by ParseArchiveTask::merge(): entries of archives used by this run, taken from cache or parsed.
+		std::vector<OptDependsArchivesCache::Entry> optDependsArchivesCacheEntries;
+		size_t numArchivesParsed = 0;
+		// Filled by ParseArchiveTask::merge(): optdepends whose archives are missing, and cached entries are not enough to answer.
+		std::vector<alloc::String> optDependsWithMissingArchives;
+
 		// Sanity check: "-\\d" in package dirName is beginning of package version.
 		// UPD: There's a package named "qt6-5compat". I've had it. Should not be THAT paranoid anyway.
 //		std::regex rPackageName {"^[A-Za-z_][^\\-]*(-[^\\-0-9][^\\-]*)*$"};
@@ -39,7 +89,29 @@ namespace dimgel {
 			//    This then is merge()d into data.libs for Resolver re-run.
 			std::unordered_map<PathAndBitnessKey, File*> libs;
 
+			std::chrono::steady_clock::duration duration {};
+
+			// Set by lookupCache(). If cachedEntry is set, compute() replays callbacks from it instead of calling impl(), if it's enough.
+			uint64_t archiveSize = 0;
+			int64_t archiveMTime = 0;
+			bool isArchiveFound = false;
+			std::optional<OptDependsArchivesCache::Entry> cachedEntry;
+			bool isReplaying = false;
+			bool isFromCache = false;
+			bool isArchiveNeeded = false;
+
+			// Recorded by callbacks while impl() runs, for new cache entry. Strings are allocated in ctx.mm.
+			std::vector<std::pair<std::string_view, std::string_view>> recordedSymlinks;
+			std::vector<std::string_view> recordedFilePaths1;
+			std::vector<OptDependsArchivesCache::InspectedFile> recordedInspectedFiles;
+			OptDependsArchivesCache::Entry newEntry;
+
 			bool onFileIsNeeded_impl(StringRef filePath1);
+			// Common part of onFileContents() and replayCache().
+			void onFileInspected(File* f);
+			// Returns false if cached entry lacks ELF summary of some needed file; then task state is left as if nothing was replayed.
+			bool replayCache();
+			void fillNewEntry();
 
 		protected:
 			alloc::String optDepName;
@@ -52,9 +124,12 @@ namespace dimgel {
 			// File contents can be binary (it's unpacked ELF file), so not using BufAndRef: its member StringRef hints for text data.
 			void onFileContents(const char* filePath1, char* buf, size_t size);
 
-			// Archive must be scanned twice:
+			// Callbacks must be called in this order:
 			// 1. `onSymlink()` callback must be called for all symlinks; finally, `onSymlinksDone()` must be called.
 			// 2. `if (onFileIsNeeded()) onFileContents(decompresedData)` for all regular files.
+			// Symlinks may be taken from archive's own listing (if it precedes payload) to do it in single pass; otherwise archive is scanned twice.
+			// Callbacks also record archive listing for OptDependsArchivesCache, so onFileIsNeeded() must be called for every regular file,
+			// even if scan stops early.
 			// Also, p.name, p.version and p.provides must be filled.
 			virtual void impl(Package* p) = 0;
 
@@ -62,23 +137,102 @@ namespace dimgel {
 			ParseArchiveTask(PacMan& owner, alloc::String optDepName,alloc::String archiveName)
 				: owner(owner), optDepName(optDepName), archiveName(archiveName) {}
 
+			// Called before scheduling: stats archive and takes matching entry from owner.optDependsArchivesCache, if any.
+			// Entry matches if archive's size and mtime are same, or if archive is missing.
+			void lookupCache();
+			bool isCached() const noexcept { return cachedEntry.has_value(); }
+			// For scheduling: processOptionalDependencies() starts largest archives first. Returns 0 if unknown.
+			uint64_t getArchiveSize() const noexcept { return archiveSize; }
+
 			void compute() final override;
 			void merge() final override;
 		};
 
 
+		// Filter for package file lists: returns false for paths which cannot be dynamic ELF-s (docs, headers, scripts, etc.),
+		// so parseInstalledPackage() does not store them. FilesCollector looks up data.packagesByFilePath1 only for dynamic ELF-s.
+		static bool isOwnedFileRelevant(std::string_view filePath1);
+
+		// Returns key of data.unresolvedNeededLibNames matching path or its file name, or nullptr (most frequent result).
+		const alloc::String* findUnresolvedNeededLib(std::string_view filePath1) const;
+
 		// Param `installedPackageUniqueID` is opaque value for base class.
 		virtual void iterateInstalledPackages(std::function<void(std::string installedPackageUniqueID)> f) = 0;
 
 		struct parseInstalledPackage_Result {
 			Package* p;
-			alloc::StringHashSet filePaths1;
+			// Owned file paths, pointing into filePaths1Buf (not into ctx.mm: it's temporary, data.packagesByFilePath1 stores paths front-coded).
+			// Sorted by parseInstalledPackages() for k-way merge.
+			std::unique_ptr<char[]> filePaths1Buf;
+			std::vector<std::string_view> filePaths1;
+
+			// Filled by parseInstalledPackages(), for InstalledPackagesCache.
+			std::string installedPackageUniqueID;
+			int64_t mtime = 0;
+			bool isFromCache = false;
+		};
+
+		// Called in parallel. If !withFiles, result.filePaths1 is left empty (lazy ownership mode).
+		virtual parseInstalledPackage_Result parseInstalledPackage(const std::string& installedPackageUniqueID, bool withFiles) = 0;
+		// Called in parallel. Reads only package's file list into result.filePaths1 (unsorted), without parsing package metadata again.
+		virtual void parseInstalledPackageFiles(const std::string& installedPackageUniqueID, parseInstalledPackage_Result& result) = 0;
+
+		// Called in parallel. Fills r.filePaths1 (sorted) from cache or by re-parsing package; r.p is not changed.
+		void readInstalledPackageFiles(const InstalledPackage& ip, parseInstalledPackage_Result& r);
+
+		// Saves InstalledPackagesCache, logging failure: it's not fatal.
+		void saveInstalledPackagesCache(const std::vector<InstalledPackagesCache::Entry>& entries);
+
+		// Sharded k-way merge of sorted file lists into data.packagesByFilePath1.
+		void buildPackagesByFilePath1(const std::vector<parseInstalledPackage_Result>& results);
+
+		// Queues ParseArchiveTask for each located optdepend (with non-empty archive name) which is not queued yet. Does not wait.
+		void queueParseArchiveTasks();
+		// Called at the end of processOptionalDependencies().
+		void saveOptDependsArchivesCache();
+
+		// Returns false if archive is not found.
+		virtual bool statArchive(std::string_view archiveName, uint64_t& size, int64_t& mtime) = 0;
+		virtual const char* getOptDependsArchivesCachePath() = 0;
+
+		// Called by calculateOptionalDependencies(); uses sync databases, if any.
+		void filterOptionalDependenciesBySyncDatabases();
+
+		// For InstalledPackagesCache validation: modification time of whole installed packages database (changes when packages are added or removed),
+		// and of single package (called in parallel). Returned values are opaque and only compared for equality.
+		virtual int64_t getInstalledPackagesMTime() = 0;
+		virtual int64_t getInstalledPackageMTime(const std::string& installedPackageUniqueID) = 0;
+		virtual const char* getInstalledPackagesCachePath() = 0;
+
+		// Parses soname entry in package's `provides` list, e.g. "libasound.so=2-64" ---> soname "libasound.so.2", 64-bit.
+		// Such entries are generated by makepkg for libraries listed in PKGBUILD's `provides`. Returns false if it's not soname entry.
+		static bool parseSonameProvides(std::string_view provides, std::string& soname, bool& is32);
+
+		// Sync databases (repositories' package lists), for calculateOptionalDependencies() to skip optdepends which cannot provide needed libs.
+		// One per repository; if `hasFiles`, database also lists all files of each package. Empty if there are none.
+		struct SyncDatabase {
+			std::string path;
+			bool hasFiles;
 		};
+		virtual std::vector<SyncDatabase> getSyncDatabases() = 0;
 
-		// Called in parallel.
-		virtual parseInstalledPackage_Result parseInstalledPackage(const std::string& installedPackageUniqueID) = 0;
+		struct SyncPackage {
+			std::string_view name;
+			std::vector<std::string_view> provides;
+			std::vector<std::string_view> filePaths1;   // Regular files and symlinks only; empty if !SyncDatabase::hasFiles.
+			// Package archive in repository; empty if not declared.
+			std::string_view archiveName;
+			uint64_t archiveSize = 0;
+			std::string_view archiveSHA256;
+		};
+		// Calls f() for each package in database; string_view-s are valid until f() returns. Called in parallel for different databases.
+		virtual void parseSyncDatabase(const SyncDatabase& db, std::function<void(const SyncPackage& p)> f) = 0;
 
 		virtual void downloadOptionalDependencies_impl() = 0;
+		// Downloads archives of given optdepends without installing them. May locate downloaded archives (set data.archiveNamesByOptDepend)
+		// and call queueParseArchiveTasks() as it goes. Also called by processOptionalDependencies() for archives which were removed
+		// from package manager's cache since they were cached by me, if cached entries turned out not enough.
+		virtual void downloadArchives(const std::vector<alloc::String>& optDepends) = 0;
 
 		virtual std::unique_ptr<ParseArchiveTask> createParseArchiveTask(alloc::String optDepName, alloc::String archiveName) = 0;
 
@@ -87,6 +241,15 @@ namespace dimgel {
 		virtual ~PacMan() {}
 
 		void parseInstalledPackages();
+
+		// Lazy ownership mode: parseInstalledPackages() reads only package names, versions, provides & optdepends; file lists are read on demand.
+		// In eager mode these are no-ops: data.packagesByFilePath1 already contains all installed files.
+		//
+		// Fills data.packagesByFilePath1 with files of given packages only; called before FilesCollector for packages referenced by addLibPath.
+		void loadInstalledPackagesFiles(const std::vector<Package*>& packages);
+		// Assigns File::belongsToPackage for files left unresolved by Resolver; called before their packages' optdepends are needed.
+		void assignUnresolvedFiles();
+
 		void calculateOptionalDependencies();
 		void downloadOptionalDependencies();
 		void processOptionalDependencies();
@@ -1,6 +1,6 @@
 #pragma once
 
-#include <regex>
+#include <span>
 #include "ELFInspector.h"
 #include "PacMan.h"
 
@@ -8,10 +8,19 @@
 namespace dimgel {
 	class PacMan_Arch final : public PacMan {
 		std::string installedInfoPath = "/var/lib/pacman/local";
+		std::string syncInfoPath = "/var/lib/pacman/sync";
 		std::string archivesPath = "/var/cache/pacman/pkg/";
 		std::string archivesURL = "file://" + archivesPath;
-		std::regex rPacmanSWPLine {"^(\\S+) (\\S+)$"};
-		std::regex rPkginfoSWPLine {"^(\\S+)\\s*=\\s*(\\S.*)$"};
+		std::string installedPackagesCachePath = "/var/cache/check-link-consistency/installed-packages.cache";
+		std::string optDependsArchivesCachePath = "/var/cache/check-link-consistency/optdeps-archives.cache";
+
+		// Max targets per `pacman -Sw` call, so that first archives are parsed while next ones are downloaded. Each call costs pacman's startup
+		// (reading sync databases), and pacman downloads in parallel only within single call (ParallelDownloads in pacman.conf), so not too small.
+		static constexpr size_t downloadBatchSize = 16;
+
+
+		// Parses `desc` or `files` of installed package into `result`. Sections of `desc` are written to result.p, %FILES% to result.filePaths1.
+		void parseInstalledPackageFile(StringRef dirPath, const char* fileName, parseInstalledPackage_Result& result);
 
 
 		class ParseArchiveTask : public PacMan::ParseArchiveTask {
@@ -26,9 +35,27 @@ namespace dimgel {
 	protected:
 		// Here installedPackageUniqueID is subdirectory name inside `installedInfoPath`.
 		void iterateInstalledPackages(std::function<void(std::string installedPackageUniqueID)> f) override;
-		parseInstalledPackage_Result parseInstalledPackage(const std::string& installedPackageUniqueID) override;
+		parseInstalledPackage_Result parseInstalledPackage(const std::string& installedPackageUniqueID, bool withFiles) override;
+		void parseInstalledPackageFiles(const std::string& installedPackageUniqueID, parseInstalledPackage_Result& result) override;
+		int64_t getInstalledPackagesMTime() override;
+		int64_t getInstalledPackageMTime(const std::string& installedPackageUniqueID) override;
+		const char* getInstalledPackagesCachePath() override { return installedPackagesCachePath.c_str(); }
+		bool statArchive(std::string_view archiveName, uint64_t& size, int64_t& mtime) override;
+		const char* getOptDependsArchivesCachePath() override { return optDependsArchivesCachePath.c_str(); }
+		std::vector<SyncDatabase> getSyncDatabases() override;
+		void parseSyncDatabase(const SyncDatabase& db, std::function<void(const SyncPackage& p)> f) override;
+
+		// Calls f() for each `pacman {options} {targets chunk}` command line, see definition. Chunk has at most maxTargets targets.
+		void forEachPacmanCommand(
+			std::initializer_list<const char*> options, const std::vector<alloc::String>& targets,
+			std::function<void(std::vector<const char*>& argv, std::span<const alloc::String> chunk)> f, size_t maxTargets = SIZE_MAX
+		);
+		const SyncArchive* findSyncArchive(const alloc::String& optdep) const;
+		// Called in parallel.
+		bool setArchiveName(alloc::String optDepName, std::string_view url, alloc::String& archiveName);
 
 		virtual void downloadOptionalDependencies_impl() override;
+		void downloadArchives(const std::vector<alloc::String>& optDepends) override;
 		std::unique_ptr<PacMan::ParseArchiveTask> createParseArchiveTask(alloc::String optDepName, alloc::String archiveName) override {
 			return std::make_unique<ParseArchiveTask>(*this, optDepName, archiveName);
 		}
@@ -1,11 +1,16 @@
 #include <archive_entry.h>
+#include <charconv>
+#include <fcntl.h>
 #include <filesystem>
 #include <functional>
 #include <map>
+#include <openssl/evp.h>
 #include <ranges>
 #include <sys/stat.h>
+#include <unordered_set>
 #include "PacMan_Arch.h"
 #include "util/ArchiveReader.h"
+#include "util/Closeable.h"
 #include "util/Error.h"
 #include "util/Log.h"
 #include "util/SplitMutableString.h"
@@ -32,90 +37,98 @@ namespace dimgel {
 	//----------------------------------------------------------------------------------------------------------------------------------------
 
 
-	PacMan::parseInstalledPackage_Result PacMan_Arch::parseInstalledPackage(const std::string& installedPackageUniqueID) {
-		PacMan::parseInstalledPackage_Result result;
-		result.p = Package::create(ctx.mm);
+	void PacMan_Arch::parseInstalledPackageFile(StringRef dirPath, const char* fileName, parseInstalledPackage_Result& result) {
+		// Called for ~1500 packages x 2 files, so buffer is reused by all calls in this thread instead of being allocated per file.
+		// All values are copied to ctx.mm or result.filePaths1Buf before next call.
+		thread_local std::vector<char> buf;
+		thread_local std::vector<std::string_view> filePaths1;
 
-		auto& dirName = installedPackageUniqueID;
-		char dirPathBuf[PATH_MAX];
-		auto dirPath = util::concatStringViews(dirPathBuf, sizeof(dirPathBuf), {installedInfoPath.c_str(), "/", dirName.c_str()});
+		char filePathBuf[PATH_MAX];
+		auto filePath = util::concatStringViews(filePathBuf, PATH_MAX, {dirPath.sv(), "/", fileName});
+		SplitMutableString lines(util::readFile(filePath.cp(), buf));
 
-		struct openFile_Result {
-			StringRef path;
-			BufAndRef contents;
+		auto getLine = [&](SplitMutableString::ConstIterator& it) {
+			if (it == it.getOwner().end()) {
+				throw Error(FILE_LINE "read `%s` line %d: unexpected EOF", filePathBuf, it.getPartNo());
+			}
+			return *it++;
 		};
-		auto openFile = [&](const char* fileName, char filePathBuf[PATH_MAX]) {
-			auto filePath = util::concatStringViews(filePathBuf, PATH_MAX, {dirPath.sv(), "/", fileName});
-			if (!fs::is_regular_file(filePath.sv())) {
-				throw Error(FILE_LINE "read `%s`: not a regular file", filePathBuf);
+		auto skipEmptyLine = [&](SplitMutableString::ConstIterator& it) {
+			if (it == it.getOwner().end()) {
+				throw Error(FILE_LINE "read `%s` line %d: expected empty line, got EOF", filePathBuf, it.getPartNo());
 			}
-			auto contents = util::readFile(filePath.cp());
-			return openFile_Result{.path = filePath, .contents = std::move(contents)};
+			if (!it->empty()) {
+				throw Error(FILE_LINE "read `%s` line %d: expected empty line", filePathBuf, it.getPartNo());
+			}
+			++it;
 		};
 
-		auto readFile = [&](const char* fileName) {
-			char filePathBuf[PATH_MAX];
-			auto file = openFile(fileName, filePathBuf);
-			SplitMutableString lines(file.contents.ref);
-
-			auto getLine = [&](SplitMutableString::ConstIterator& it) {
-				if (it == it.getOwner().end()) {
-					throw Error(FILE_LINE "read `%s` line %d: unexpected EOF", filePathBuf, it.getPartNo());
+		for (auto it = lines.begin();  it != lines.end();  ) {
+			auto sv = *it++;
+			if (sv.empty()) {
+				// Skipping leading & multiple empty lines.
+			} else if (sv == "%NAME%") {
+				result.p->name = alloc::String{ctx.mm, getLine(it)};
+				skipEmptyLine(it);
+			} else if (sv == "%VERSION%") {
+				result.p->version = alloc::String{ctx.mm, getLine(it)};
+				skipEmptyLine(it);
+			} else if (sv == "%PROVIDES%") {
+				while (!(sv = getLine(it)).empty()) {
+					result.p->provides.insert(alloc::String{ctx.mm, sv});
 				}
-				return *it++;
-			};
-			auto skipEmptyLine = [&](SplitMutableString::ConstIterator& it) {
-				if (it == it.getOwner().end()) {
-					throw Error(FILE_LINE "read `%s` line %d: expected empty line, got EOF", filePathBuf, it.getPartNo());
-				}
-				if (!it->empty()) {
-					throw Error(FILE_LINE "read `%s` line %d: expected empty line", filePathBuf, it.getPartNo());
+			} else if (sv == "%OPTDEPENDS%") {
+				while (!(sv = getLine(it)).empty()) {
+					auto i = sv.find(':');
+					result.p->optDepends.insert(alloc::String{ctx.mm, i == std::string::npos ? sv.sv() : sv.substr(0, i)});
 				}
-				++it;
-			};
-
-			for (auto it = lines.begin();  it != lines.end();  ) {
-				auto sv = *it++;
-				if (sv.empty()) {
-					// Skipping leading & multiple empty lines.
-				} else if (sv == "%NAME%") {
-					result.p->name = alloc::String{ctx.mm, getLine(it)};
-					skipEmptyLine(it);
-				} else if (sv == "%VERSION%") {
-					result.p->version = alloc::String{ctx.mm, getLine(it)};
-					skipEmptyLine(it);
-				} else if (sv == "%PROVIDES%") {
-					while (!(sv = getLine(it)).empty()) {
-						result.p->provides.insert(alloc::String{ctx.mm, sv});
-					}
-				} else if (sv == "%OPTDEPENDS%") {
-					while (!(sv = getLine(it)).empty()) {
-						auto i = sv.find(':');
-						result.p->optDepends.insert(alloc::String{ctx.mm, i == std::string::npos ? sv.sv() : sv.substr(0, i)});
+			} else if (sv == "%FILES%") {
+				filePaths1.clear();
+				while (!(sv = getLine(it)).empty()) {
+					// Filter out directories and files which are never looked up.
+					if (!sv.ends_with('/') && isOwnedFileRelevant(sv.sv())) {
+						// Pacman assumes these are real paths without leading '/' (root prefix), see notes/sources-pacman.txt.
+						filePaths1.push_back(sv.sv());
 					}
-				} else if (sv == "%FILES%") {
-					while (!(sv = getLine(it)).empty()) {
-						// Filter out directories.
-						if (!sv.ends_with('/')) {
-							// Pacman assumes these are real paths without leading '/' (root prefix), see notes/sources-pacman.txt.
-							result.filePaths1.insert(alloc::String{ctx.mm, sv});
-						}
-					}
-				} else if (sv[0] == '%') {
-					while (!(sv = getLine(it)).empty()) {
-						// Skip unknown section, make sure it also ends with empty line.
-					}
-				} else {
-					throw Error(FILE_LINE "read `%s` line %d: expected %%SECTION_NAME%%", filePathBuf, it.getPartNo() - 1);
 				}
+				size_t n = 0;
+				for (auto s : filePaths1) {
+					n += s.length();
+				}
+				result.filePaths1Buf = std::make_unique_for_overwrite<char[]>(n);
+				result.filePaths1.reserve(filePaths1.size());
+				char* buf = result.filePaths1Buf.get();
+				for (auto s : filePaths1) {
+					memcpy(buf, s.data(), s.length());
+					result.filePaths1.push_back({buf, s.length()});
+					buf += s.length();
+				}
+			} else if (sv[0] == '%') {
+				while (!(sv = getLine(it)).empty()) {
+					// Skip unknown section, make sure it also ends with empty line.
+				}
+			} else {
+				throw Error(FILE_LINE "read `%s` line %d: expected %%SECTION_NAME%%", filePathBuf, it.getPartNo() - 1);
 			}
-		};
+		}
+	}
+
+
+	PacMan::parseInstalledPackage_Result PacMan_Arch::parseInstalledPackage(const std::string& installedPackageUniqueID, bool withFiles) {
+		PacMan::parseInstalledPackage_Result result;
+		result.p = Package::create(ctx.mm);
+
+		auto& dirName = installedPackageUniqueID;
+		char dirPathBuf[PATH_MAX];
+		auto dirPath = util::concatStringViews(dirPathBuf, sizeof(dirPathBuf), {installedInfoPath.c_str(), "/", dirName.c_str()});
 
 		// Pacman reads both files in single function, so do I.
 		// NOTE: Considered reading `mtree` file instead of `files` so I could filter in only regular files with x-permission, *.so[.*] extension and symlinks;
 		//       But `mtree` files are gzipped and still they are larger than `files`, hence no profit.
-		readFile("desc");
-		readFile("files");
+		parseInstalledPackageFile(dirPath, "desc", result);
+		if (withFiles) {
+			parseInstalledPackageFile(dirPath, "files", result);
+		}
 
 		char packageNameVer[200];
 		if (util::concatStringViews(packageNameVer, sizeof(packageNameVer), {result.p->name.sv(), "-", result.p->version.s()}) != dirName) {
@@ -126,159 +139,530 @@ namespace dimgel {
 	} // PacMan_Arch::parseInstalledPackage()
 
 
+	void PacMan_Arch::parseInstalledPackageFiles(const std::string& installedPackageUniqueID, parseInstalledPackage_Result& result) {
+		char dirPathBuf[PATH_MAX];
+		auto dirPath = util::concatStringViews(dirPathBuf, sizeof(dirPathBuf), {installedInfoPath.c_str(), "/", installedPackageUniqueID.c_str()});
+		parseInstalledPackageFile(dirPath, "files", result);
+	}
+
+
+	// Pacman creates new directory for each installed or upgraded package, and removes old one; so directory mtime-s are enough,
+	// desc & files contents don't need to be checked.
+	int64_t PacMan_Arch::getInstalledPackagesMTime() {
+		return util::statx(installedInfoPath.c_str()).mtimeNs;
+	}
+
+
+	int64_t PacMan_Arch::getInstalledPackageMTime(const std::string& installedPackageUniqueID) {
+		char dirPathBuf[PATH_MAX];
+		auto dirPath = util::concatStringViews(dirPathBuf, sizeof(dirPathBuf), {installedInfoPath.c_str(), "/", installedPackageUniqueID.c_str()});
+		return util::statx(dirPath.cp()).mtimeNs;
+	}
+
+
 	//----------------------------------------------------------------------------------------------------------------------------------------
 
 
-	void PacMan_Arch::downloadOptionalDependencies_impl() {
-		// 1. Download optDeps without installing. Split too large command line into multiple exec() calls.
-		// "POSIX suggests to subtract 2048 additionally so that the process may savely modify its environment." (c) https://stackoverflow.com/a/14419676
-		if (!ctx.noNetwork) {
-			long argsMaxLength {sysconf(_SC_ARG_MAX) - 2048};
-			if (argsMaxLength < 0) {
-				throw Error(FILE_LINE "sysconf() failed: %s", strerror(errno));
-			}
-			std::vector<const char*> argv;
-			argv.reserve(data.optDependsSorted.size());
-			for (auto it = data.optDependsSorted.begin();  it != data.optDependsSorted.end();  ) {
-				{
-					long argsCurLength = 0;
-
-					auto addArg = [&](StringRef s) -> bool {
-						if (argsCurLength + (long)s.size() + 1 > argsMaxLength) {
-							return false;
-						}
-						argv.push_back(s.cp());
-						argsCurLength += s.size() + 1;
-						return true;
-					};
-
-					argv.clear();
-					addArg("/usr/bin/pacman");
-					addArg("-Sw");
-					addArg(ctx.colorize ? "--color=always" : "--color=never");
-					addArg("--noconfirm");
-					while (it != data.optDependsSorted.end() && addArg(*it)) {
-						++it;
+	// `pacman -Fy` downloads `{repo}.files` next to `{repo}.db`; it contains same `desc` entries plus `files` entries.
+	std::vector<PacMan::SyncDatabase> PacMan_Arch::getSyncDatabases() {
+		std::vector<std::string> dbNames;
+		std::unordered_set<std::string> filesNames;
+		util::scanDir(syncInfoPath.c_str(), [&](const dirent& de) {
+			if (de.d_type != DT_REG) {
+				return;
+			}
+			std::string_view name = de.d_name;
+			if (name.ends_with(".db")) {
+				dbNames.emplace_back(name.substr(0, name.length() - 3));
+			} else if (name.ends_with(".files")) {
+				filesNames.emplace(name.substr(0, name.length() - 6));
+			}
+		});
+		util::sort(dbNames);
+
+		std::vector<SyncDatabase> result;
+		result.reserve(dbNames.size());
+		for (auto& repo : dbNames) {
+			std::string basePath = syncInfoPath + "/" + repo;
+			bool hasFiles = filesNames.contains(repo);
+			if (hasFiles) {
+				// `pacman -Sy` refreshes only `.db`, `.files` is refreshed by `pacman -Fy`. Stale `.files` would give outdated file lists and archives.
+				struct stat stDB, stFiles;
+				if (stat((basePath + ".db").c_str(), &stDB) == 0 && stat((basePath + ".files").c_str(), &stFiles) == 0
+						&& (stFiles.st_mtim.tv_sec < stDB.st_mtim.tv_sec
+							|| (stFiles.st_mtim.tv_sec == stDB.st_mtim.tv_sec && stFiles.st_mtim.tv_nsec < stDB.st_mtim.tv_nsec))) {
+					hasFiles = false;
+					if (ctx.verbosity >= Verbosity_WarnAndExec) {
+						ctx.log.warn(FILE_LINE "`%s.files` is older than `%s.db`, using the latter; run `pacman -Fy` to refresh it", basePath.c_str(), basePath.c_str());
 					}
-					argv.push_back(nullptr);
+				}
+			}
+			result.push_back({.path = basePath + (hasFiles ? ".files" : ".db"), .hasFiles = hasFiles});
+		}
+		return result;
+	}
 
-					if (ctx.verbosity >= Verbosity_WarnAndExec) {
-						std::ostringstream os;
-						os << argv[0];
-						for (size_t i = 1;  i < argv.size() - 1;  i++) {
-							os << ' ' << argv[i];
+
+	// Database is archive with `{name}-{version}/desc` entry per package, in same format as installed package's `desc` file,
+	// and for `.files` database, with `{name}-{version}/files` entry. Package is passed to f() as soon as all its entries are read;
+	// repo-add writes them adjacent, so `pending` map usually contains at most one package.
+	void PacMan_Arch::parseSyncDatabase(const SyncDatabase& db, std::function<void(const SyncPackage& p)> f) {
+		struct Pending {
+			BufAndRef descBuf;
+			BufAndRef filesBuf;
+			SyncPackage sp;
+		};
+		std::unordered_map<std::string, Pending> pending;
+
+		auto done = [&](const std::string& dir, Pending& pk) {
+			if (pk.sp.name.empty()) {
+				throw Error(FILE_LINE "read `%s` / `%s`: no package name", db.path.c_str(), dir.c_str());
+			}
+			f(pk.sp);
+		};
+
+		ArchiveReader a(db.path);
+		a.scanAll([&](archive_entry* e) {
+			if (archive_entry_filetype(e) != AE_IFREG) {
+				return;
+			}
+			std::string_view entryPath = archive_entry_pathname(e);
+			auto iSlash = entryPath.rfind('/');
+			if (iSlash == std::string_view::npos) {
+				return;
+			}
+			std::string dir {entryPath.substr(0, iSlash)};
+			auto entryName = entryPath.substr(iSlash + 1);
+			bool isDesc = entryName == "desc";
+			if (!isDesc && !(db.hasFiles && entryName == "files")) {
+				return;
+			}
+
+			auto itPending = pending.try_emplace(dir).first;
+			auto& pk = itPending->second;
+			auto& bufAndRef = isDesc ? pk.descBuf : pk.filesBuf;
+			bufAndRef = a.getEntryData(e);
+			SplitMutableString lines(bufAndRef.ref);
+			for (auto it = lines.begin();  it != lines.end();  ) {
+				auto sv = *it++;
+				if (isDesc && sv == "%NAME%") {
+					if (it == lines.end()) {
+						throw Error(FILE_LINE "read `%s` / `%s`: unexpected EOF", db.path.c_str(), dir.c_str());
+					}
+					pk.sp.name = (*it++).sv();
+				} else if (isDesc && (sv == "%FILENAME%" || sv == "%CSIZE%" || sv == "%SHA256SUM%")) {
+					if (it == lines.end()) {
+						throw Error(FILE_LINE "read `%s` / `%s`: unexpected EOF", db.path.c_str(), dir.c_str());
+					}
+					auto value = (*it++).sv();
+					if (sv == "%FILENAME%") {
+						pk.sp.archiveName = value;
+					} else if (sv == "%SHA256SUM%") {
+						pk.sp.archiveSHA256 = value;
+					} else if (std::from_chars(value.data(), value.data() + value.length(), pk.sp.archiveSize).ec != std::errc()) {
+						throw Error(FILE_LINE "read `%s` / `%s`: bad %%CSIZE%% value", db.path.c_str(), dir.c_str());
+					}
+				} else if (isDesc && sv == "%PROVIDES%") {
+					while (it != lines.end() && !it->empty()) {
+						pk.sp.provides.push_back((*it++).sv());
+					}
+				} else if (!isDesc && sv == "%FILES%") {
+					for (;  it != lines.end() && !it->empty();  ++it) {
+						if (!it->ends_with('/')) {
+							pk.sp.filePaths1.push_back(it->sv());
 						}
-						ctx.log.exec("%s", os.str().c_str());
 					}
 				}
+			}
 
-				try {
-					util::forkExecStdCapture(argv.data(), {.requireStatus0 = true, .captureStdOut = ctx.verbosity < Verbosity_WarnAndExec, .captureStdErr = false});
-				} catch (std::exception& e) {
-					// Pacman may fail to complete transaction because user added some dependencies or their sub-dependencies to IgnorePkg in /etc/pacman.conf,
-					// but more likely user pressed Ctrl+C. So, `break` instead of `continue`: don't download rest of optdeps.
-					throw Error(
-						FILE_LINE "exec(pacman -Sw) failed: %s"
-								"\n      Aborting: downloaded archives can be damaged.",
-						e.what()
-					);
+			if (pk.descBuf.buf && (!db.hasFiles || pk.filesBuf.buf)) {
+				done(dir, pk);
+				pending.erase(itPending);
+			}
+		});
+
+		// Packages with missing `files` entry (or `desc` entry, which is error).
+		for (auto& [dir, pk] : pending) {
+			done(dir, pk);
+		}
+	}
+
+
+	//----------------------------------------------------------------------------------------------------------------------------------------
+
+
+	// Splits too large command line into multiple exec() calls.
+	// "POSIX suggests to subtract 2048 additionally so that the process may savely modify its environment." (c) https://stackoverflow.com/a/14419676
+	void PacMan_Arch::forEachPacmanCommand(
+		std::initializer_list<const char*> options, const std::vector<alloc::String>& targets,
+		std::function<void(std::vector<const char*>& argv, std::span<const alloc::String> chunk)> f, size_t maxTargets
+	) {
+		long argsMaxLength {sysconf(_SC_ARG_MAX) - 2048};
+		if (argsMaxLength < 0) {
+			throw Error(FILE_LINE "sysconf() failed: %s", strerror(errno));
+		}
+		std::vector<const char*> argv;
+		argv.reserve(targets.size() + options.size() + 2);
+		for (auto it = targets.begin();  it != targets.end();  ) {
+			long argsCurLength = 0;
+
+			auto addArg = [&](StringRef s) -> bool {
+				if (argsCurLength + (long)s.size() + 1 > argsMaxLength) {
+					return false;
+				}
+				argv.push_back(s.cp());
+				argsCurLength += s.size() + 1;
+				return true;
+			};
+
+			argv.clear();
+			addArg("/usr/bin/pacman");
+			for (auto o : options) {
+				addArg(o);
+			}
+			auto chunkBegin = it;
+			while (it != targets.end() && (size_t)(it - chunkBegin) < maxTargets && addArg(*it)) {
+				++it;
+			}
+			argv.push_back(nullptr);
+
+			if (ctx.verbosity >= Verbosity_WarnAndExec) {
+				std::ostringstream os;
+				os << argv[0];
+				for (size_t i = 1;  i < argv.size() - 1;  i++) {
+					// Quote arguments containing spaces, e.g. --print-format value.
+					if (strchr(argv[i], ' ') != nullptr) {
+						os << " '" << argv[i] << '\'';
+					} else {
+						os << ' ' << argv[i];
+					}
 				}
-			} // for (... packages.packagesByOptDepend ...)
-		} // if (!ctx.noNetwork)
+				ctx.log.exec("%s", os.str().c_str());
+			}
+			f(argv, {chunkBegin, it});
+		}
+	}
 
 
-		// 2. For each successfully downloaded optdep, ask pacman about its package name and archive file name: exec `pacman -Swp ... {optDep}`.
-		// Pacman can translate dependency name to package name (e.g. nvidia-utils=495.44 ---> nvidia-utils, libasound.so=2-64 ---> alsa-lib),
-		// and I cannot guess package name from dependency name myself. Thus, separate forkExec() call for each package.
-		class FindArchiveTask : public ThreadPool::Task {
+	// Param `url` is from `pacman -Sw --print-format '%l'` output. Returns false (and logs error) if it's not in archivesPath.
+	bool PacMan_Arch::setArchiveName(alloc::String optDepName, std::string_view url, alloc::String& archiveName) {
+		if (!url.starts_with(archivesURL) || url.length() == archivesURL.length()) {
+			// In multiline output, some sub-dependencies may be outdated and have URL "http://..." instead of "file:///var/cache/pacman/pkg/...".
+			// I don't care of them as long as requested dependency itself is downloaded. So I postponed this check until I found exact line I need.
+			ctx.log.error(
+				"skipped optional dependency `%s`: couldn't parse URL `%s`: expected `file:///...`",
+				optDepName.cp(), std::string(url).c_str()
+			);
+			return false;
+		}
+		archiveName = alloc::String{ctx.mm, url.substr(archivesURL.length())};
+		if (ctx.verbosity >= Verbosity_Debug) {
+			ctx.log.debug(FILE_LINE "resolved `%s` ---> `%s%s`", optDepName.cp(), archivesPath.c_str(), archiveName.cp());
+		}
+		return true;
+	}
+
+
+	// Same attribution rules as in step 2.1 of downloadOptionalDependencies_impl(): exact package name, or exactly one provider.
+	const PacMan::SyncArchive* PacMan_Arch::findSyncArchive(const alloc::String& optdep) const {
+		auto it = syncArchivesByPackageName.find(optdep);
+		if (it == syncArchivesByPackageName.end()) {
+			auto it2 = syncPackageNamesByOptDepend.find(optdep);
+			if (it2 == syncPackageNamesByOptDepend.end()) {
+				return nullptr;
+			}
+			auto& names = it2->second;
+			if (!std::all_of(names.begin(), names.end(), [&](auto& name) { return name == names[0]; })) {
+				return nullptr;
+			}
+			it = syncArchivesByPackageName.find(names[0]);
+			if (it == syncArchivesByPackageName.end()) {
+				return nullptr;
+			}
+		}
+		return it->second.sha256.empty() ? nullptr : &it->second;
+	}
+
+
+	//----------------------------------------------------------------------------------------------------------------------------------------
+
+
+	void PacMan_Arch::downloadOptionalDependencies_impl() {
+		const char* argvColor = ctx.colorize ? "--color=always" : "--color=never";
+
+		// 0. Most of `pacman -Sw` time is spent on validating checksums of already downloaded archives, sequentially.
+		// If sync databases told which archive each optdep resolves to, verify archives myself in parallel; verified optdeps skip both steps below.
+		// SHA-256 is computed by libcrypto: it uses SHA-NI / AVX2 code paths when CPU supports them.
+		class VerifyArchiveTask : public ThreadPool::Task {
 			PacMan_Arch& owner;
 			alloc::String optDepName;
+			const SyncArchive& sa;
 			alloc::String& archiveName;   // Mutable reference.
+			bool ok = false;
 
 		public:
-			FindArchiveTask(PacMan_Arch& owner, alloc::String optDepName, alloc::String& archiveName)
-			    : owner(owner), optDepName(optDepName), archiveName(archiveName) {}
+			VerifyArchiveTask(PacMan_Arch& owner, alloc::String optDepName, const SyncArchive& sa, alloc::String& archiveName)
+				: owner(owner), optDepName(optDepName), sa(sa), archiveName(archiveName) {}
 
 			void compute() override {
-				const char* argvColor = owner.ctx.colorize ? "--color=always" : "--color=never";
-				const char* argv[] = {
-					"/usr/bin/pacman",
-					"-Sw",
-					argvColor,
-					"--print-format",
-					"%n %l",
-					optDepName.cp(),
-					nullptr
-				};
-				if (owner.ctx.verbosity >= Verbosity_WarnAndExec) {
-					owner.ctx.log.exec("/usr/bin/pacman -Sw %s --print-format '%%n %%l' %s", argvColor, optDepName.cp());
-				}
-				util::forkExecStdCapture_Result x;
-				try {
-					x = util::forkExecStdCapture(argv, {.requireStatus0 = true, .captureStdOut = true, .captureStdErr = false});
-				} catch (std::exception& e) {
-					owner.ctx.log.error("skipping optional dependency `%s`: exec() failed: %s", optDepName.cp(), e.what());
+				// Any failure here is not an error: pacman will (re-)download archive.
+				std::string path = owner.archivesPath + sa.archiveName.s();
+				Closeable fd {open(path.c_str(), O_RDONLY)};
+				if (fd < 0) {
+					// Removed from pacman's cache, but I've inspected it before: don't download until it turns out that cached entry is not enough.
+					OptDependsArchivesCache::Entry e;
+					ok = errno == ENOENT && owner.optDependsArchivesCache.get(sa.archiveName.sv(), e) && e.size == sa.size;
+					if (ok && owner.ctx.verbosity >= Verbosity_Debug) {
+						owner.ctx.log.debug(FILE_LINE "`%s`: missing, using cached entry", path.c_str());
+					}
 					return;
 				}
+				struct stat st;
+				if (fstat(fd, &st) < 0 || (uint64_t)st.st_size != sa.size) {
+					if (owner.ctx.verbosity >= Verbosity_Debug) {
+						owner.ctx.log.debug(FILE_LINE "`%s`: size differs from sync database", path.c_str());
+					}
+					return;
+				}
+				posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
 
-				// Many commands will output multiple lines (including dependencies).
-				SplitMutableString lines(x.stdOut);
-				std::cmatch m;
-				std::string_view m2;
-				auto it = lines.begin();
-				for (;  it != lines.end();  ++it) {
-					if (!util::regex_match(*it, m, owner.rPacmanSWPLine)) {
-						owner.ctx.log.error("skipped optional dependency `%s`: couldn't parse exec() output line %d", optDepName.cp(), it.getPartNo());
+				std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> md {EVP_MD_CTX_new(), EVP_MD_CTX_free};
+				if (!md || !EVP_DigestInit_ex(md.get(), EVP_sha256(), nullptr)) {
+					if (owner.ctx.verbosity >= Verbosity_WarnAndExec) {
+						owner.ctx.log.warn(FILE_LINE "`%s`: EVP_DigestInit_ex() failed, will re-download", path.c_str());
+					}
+					return;
+				}
+				constexpr size_t bufSize = 1024 * 1024;
+				auto buf = std::make_unique<char[]>(bufSize);
+				while (true) {
+					ssize_t n = read(fd, buf.get(), bufSize);
+					if (n < 0) {
+						if (errno == EINTR) {
+							continue;
+						}
+						if (owner.ctx.verbosity >= Verbosity_WarnAndExec) {
+							owner.ctx.log.warn(FILE_LINE "`%s`: read() failed, will re-download: %s", path.c_str(), strerror(errno));
+						}
 						return;
 					}
-					if (m[1] == optDepName) {
-						m2 = {m[2].first, m[2].second};
+					if (n == 0) {
 						break;
 					}
-				}
-				if (m2.empty()) {
-					if (it.getPartNo() == 1) {
-						owner.ctx.log.error("skipped optional dependency `%s`: exec() output is empty", optDepName.cp());
+					if (!EVP_DigestUpdate(md.get(), buf.get(), n)) {
+						if (owner.ctx.verbosity >= Verbosity_WarnAndExec) {
+							owner.ctx.log.warn(FILE_LINE "`%s`: EVP_DigestUpdate() failed, will re-download", path.c_str());
+						}
 						return;
 					}
-					m2 = {m[2].first, m[2].second};
-					if (it.getPartNo() > 2 && owner.ctx.verbosity >= Verbosity_WarnAndExec) {
-						// This is OK until PacMan::ParseArchiveTask::compute() finds out that chosen package does not match optDepName.
-						owner.ctx.log.warn(
-							FILE_LINE "rewritten optional dependency `%s` ---> `%s`: exec() output has multiple lines without exact match, took last line",
-							optDepName.cp(), m[1].str().c_str()
-						);
-					}
 				}
-				if (!m2.starts_with(owner.archivesURL) || m2.length() == owner.archivesURL.length()) {
-					// In multiline output, some sub-dependencies may be outdated and have URL "http://..." instead of "file:///var/cache/pacman/pkg/...".
-					// I don't care of them as long as requested dependency itself is downloaded. So I postponed this check until I found exact line I need.
-					owner.ctx.log.error(
-						"skipped optional dependency `%s`: couldn't parse URL `%s`: expected `file:///...`",
-						optDepName.cp(), std::string(m2).c_str()
-					);
+				unsigned char digest[EVP_MAX_MD_SIZE];
+				unsigned int digestLength;
+				if (!EVP_DigestFinal_ex(md.get(), digest, &digestLength)) {
+					if (owner.ctx.verbosity >= Verbosity_WarnAndExec) {
+						owner.ctx.log.warn(FILE_LINE "`%s`: EVP_DigestFinal_ex() failed, will re-download", path.c_str());
+					}
 					return;
 				}
-				archiveName = alloc::String{owner.ctx.mm, m2.substr(owner.archivesURL.length())};
-				if (owner.ctx.verbosity >= Verbosity_Debug) {
-					owner.ctx.log.debug(
-						FILE_LINE "resolved `%s` ---> `%s%s`",
-						optDepName.cp(), owner.archivesPath.c_str(), archiveName.cp()
-					);
+
+				static constexpr char hexDigits[] = "0123456789abcdef";
+				char hex[EVP_MAX_MD_SIZE * 2];
+				for (unsigned int i = 0;  i < digestLength;  i++) {
+					hex[i * 2] = hexDigits[digest[i] >> 4];
+					hex[i * 2 + 1] = hexDigits[digest[i] & 0xF];
+				}
+				ok = std::string_view(hex, digestLength * 2) == sa.sha256.sv();
+				if (!ok && owner.ctx.verbosity >= Verbosity_WarnAndExec) {
+					owner.ctx.log.warn(FILE_LINE "`%s`: SHA-256 differs from sync database, will re-download", path.c_str());
 				}
 			}
 
 			void merge() override {
+				if (ok) {
+					archiveName = sa.archiveName;
+					if (owner.ctx.verbosity >= Verbosity_Debug) {
+						owner.ctx.log.debug(FILE_LINE "verified `%s` ---> `%s%s`", optDepName.cp(), owner.archivesPath.c_str(), archiveName.cp());
+					}
+				}
 			}
 		};
 
+		{
+			std::vector<std::pair<uint64_t, std::unique_ptr<ThreadPool::Task>>> sizesAndTasks;
+			for (auto& [optdep, archiveName] : data.archiveNamesByOptDepend) {
+				if (auto sa = findSyncArchive(optdep);  sa != nullptr) {
+					sizesAndTasks.push_back({sa->size, std::make_unique<VerifyArchiveTask>(*this, optdep, *sa, archiveName)});
+				}
+			}
+			// Largest first, so that last thread to finish does not start with big one.
+			std::sort(sizesAndTasks.begin(), sizesAndTasks.end(), [](auto& a, auto& b) { return a.first > b.first; });
+			std::vector<std::unique_ptr<ThreadPool::Task>> tasks;
+			tasks.reserve(sizesAndTasks.size());
+			for (auto& [_, t] : sizesAndTasks) {
+				tasks.push_back(std::move(t));
+			}
+			ctx.threadPool.addTasks(std::move(tasks));
+			ctx.threadPool.waitAll();
+		}
+
+		// Not verified optdeps, still sorted.
+		auto getTargets = [&] {
+			std::vector<alloc::String> targets;
+			for (auto& optdep : data.optDependsSorted) {
+				if (data.archiveNamesByOptDepend.at(optdep).empty()) {
+					targets.push_back(optdep);
+				}
+			}
+			return targets;
+		};
+		std::vector<alloc::String> targets = getTargets();
+		if (ctx.verbosity >= Verbosity_Debug) {
+			ctx.log.debug(
+				FILE_LINE "stats: optional dependencies: %lu of %lu archives verified without pacman",
+				ulong{data.optDependsSorted.size() - targets.size()}, ulong{data.optDependsSorted.size()}
+			);
+		}
+
+		// Verified archives are parsed while the rest are downloaded and located.
+		queueParseArchiveTasks();
+
+
+		// 1. Download optDeps without installing. Those known from sync databases are located and queued for parsing after each batch.
+		downloadArchives(targets);
+		targets = getTargets();
+
+
+		// 2. For each successfully downloaded optdep, ask pacman about its package name and archive file name: exec `pacman -Swp ... {optDeps}`.
+		// Pacman can translate dependency name to package name (e.g. nvidia-utils=495.44 ---> nvidia-utils, libasound.so=2-64 ---> alsa-lib),
+		// and I cannot guess package name from dependency name myself.
+		//
+		// 2.1. Batched: single exec() per ARG_MAX chunk, which outputs "{name} {url}" for all requested packages and their dependencies.
+		// Output line is attributed to optdep if its name equals optdep, or is one of optdep's providers in sync databases.
+		// If pacman fails (e.g. some optdep not found, which fails whole transaction), all optdeps go to 2.2.
+		std::unordered_map<std::string, std::string> urlsByPackageName;
+		bool batchOk = true;
+		forEachPacmanCommand({"-Sw", argvColor, "--print-format", "%n %l"}, targets, [&](std::vector<const char*>& argv, auto) {
+			if (!batchOk) {
+				return;
+			}
+			util::forkExecStdCapture_Result x;
+			try {
+				x = util::forkExecStdCapture(argv.data(), {.requireStatus0 = true, .captureStdOut = true, .captureStdErr = false});
+			} catch (std::exception& e) {
+				if (ctx.verbosity >= Verbosity_WarnAndExec) {
+					ctx.log.warn(FILE_LINE "batched exec() failed, falling back to one exec() per optional dependency: %s", e.what());
+				}
+				batchOk = false;
+				return;
+			}
+			SplitMutableString lines(x.stdOut);
+			std::string_view m1, m2;
+			for (auto it = lines.begin();  it != lines.end();  ++it) {
+				if (it->empty()) {
+					continue;
+				}
+				if (!util::parseWordSpaceWord(it->sv(), m1, m2)) {
+					if (ctx.verbosity >= Verbosity_WarnAndExec) {
+						ctx.log.warn(FILE_LINE "batched exec() output line %d: failed to parse, falling back to one exec() per optional dependency", it.getPartNo());
+					}
+					batchOk = false;
+					return;
+				}
+				urlsByPackageName.try_emplace(std::string(m1), m2);
+			}
+		});
 
-		std::vector<std::unique_ptr<ThreadPool::Task>> tasks;
-		tasks.reserve(data.archiveNamesByOptDepend.size());
+		std::vector<std::pair<alloc::String, alloc::String*>> unattributed;
 		for (auto& [optdep, archiveName] : data.archiveNamesByOptDepend) {
-			tasks.push_back(std::make_unique<FindArchiveTask>(*this, optdep, archiveName));
+			if (!archiveName.empty()) {
+				continue;
+			}
+			const std::string* url = nullptr;
+			if (batchOk) {
+				if (auto it = urlsByPackageName.find(std::string(optdep.sv()));  it != urlsByPackageName.end()) {
+					url = &it->second;
+				} else if (auto it = syncPackageNamesByOptDepend.find(optdep);  it != syncPackageNamesByOptDepend.end()) {
+					// If multiple providers are in output (e.g. one is dependency of another optdep), pacman's choice is unknown.
+					int numFound = 0;
+					for (auto& name : it->second) {
+						if (auto it2 = urlsByPackageName.find(std::string(name.sv()));  it2 != urlsByPackageName.end()) {
+							url = &it2->second;
+							numFound++;
+						}
+					}
+					if (numFound > 1) {
+						url = nullptr;
+					}
+				}
+			}
+			if (url != nullptr) {
+				setArchiveName(optdep, *url, archiveName);
+			} else {
+				unattributed.push_back({optdep, &archiveName});
+			}
 		}
-		ctx.threadPool.addTasks(ctx.threadPool.groupTasks(std::move(tasks)));
+		if (ctx.verbosity >= Verbosity_Debug) {
+			ctx.log.debug(
+				FILE_LINE "stats: optional dependencies: %lu resolved by batched exec(), %lu left for one exec() each",
+				ulong{targets.size() - unattributed.size()}, ulong{unattributed.size()}
+			);
+		}
+
+
+		// 2.2. Remaining optdeps: separate exec() call for each, then last line without exact match is the one.
+		ctx.threadPool.parallelFor(std::span(unattributed), [&](const std::pair<alloc::String, alloc::String*>& u) {
+			auto& [optDepName, archiveName] = u;
+			const char* argvColor = ctx.colorize ? "--color=always" : "--color=never";
+			const char* argv[] = {
+				"/usr/bin/pacman",
+				"-Sw",
+				argvColor,
+				"--print-format",
+				"%n %l",
+				optDepName.cp(),
+				nullptr
+			};
+			if (ctx.verbosity >= Verbosity_WarnAndExec) {
+				ctx.log.exec("/usr/bin/pacman -Sw %s --print-format '%%n %%l' %s", argvColor, optDepName.cp());
+			}
+			util::forkExecStdCapture_Result x;
+			try {
+				x = util::forkExecStdCapture(argv, {.requireStatus0 = true, .captureStdOut = true, .captureStdErr = false});
+			} catch (std::exception& e) {
+				ctx.log.error("skipping optional dependency `%s`: exec() failed: %s", optDepName.cp(), e.what());
+				return;
+			}
+
+			// Many commands will output multiple lines (including dependencies).
+			// Line format is "%n %l", i.e. "{name} {url}".
+			SplitMutableString lines(x.stdOut);
+			std::string_view m1, m2;
+			auto it = lines.begin();
+			for (;  it != lines.end();  ++it) {
+				if (!util::parseWordSpaceWord(it->sv(), m1, m2)) {
+					ctx.log.error("skipped optional dependency `%s`: couldn't parse exec() output line %d", optDepName.cp(), it.getPartNo());
+					return;
+				}
+				if (m1 == optDepName) {
+					break;
+				}
+			}
+			if (it == lines.end()) {
+				if (it.getPartNo() == 1) {
+					ctx.log.error("skipped optional dependency `%s`: exec() output is empty", optDepName.cp());
+					return;
+				}
+				// m1 and m2 are from last line.
+				if (it.getPartNo() > 2 && ctx.verbosity >= Verbosity_WarnAndExec) {
+					// This is OK until PacMan::ParseArchiveTask::compute() finds out that chosen package does not match optDepName.
+					ctx.log.warn(
+						FILE_LINE "rewritten optional dependency `%s` ---> `%s`: exec() output has multiple lines without exact match, took last line",
+						optDepName.cp(), std::string(m1).c_str()
+					);
+				}
+			}
+			setArchiveName(optDepName, m2, *archiveName);
+		});
 		ctx.threadPool.waitAll();
 
 	} // PacMan_Arch::downloadOptionalDependencies_impl()
@@ -287,50 +671,181 @@ namespace dimgel {
 	//----------------------------------------------------------------------------------------------------------------------------------------
 
 
+	void PacMan_Arch::downloadArchives(const std::vector<alloc::String>& optDepends) {
+		if (ctx.noNetwork) {
+			return;
+		}
+		const char* argvColor = ctx.colorize ? "--color=always" : "--color=never";
+		forEachPacmanCommand({"-Sw", argvColor, "--noconfirm"}, optDepends, [&](std::vector<const char*>& argv, std::span<const alloc::String> chunk) {
+			try {
+				util::forkExecStdCapture(argv.data(), {.requireStatus0 = true, .captureStdOut = ctx.verbosity < Verbosity_WarnAndExec, .captureStdErr = false});
+			} catch (std::exception& e) {
+				// Pacman may fail to complete transaction because user added some dependencies or their sub-dependencies to IgnorePkg in /etc/pacman.conf,
+				// but more likely user pressed Ctrl+C. So, `break` instead of `continue`: don't download rest of optdeps.
+				throw Error(
+					FILE_LINE "exec(pacman -Sw) failed: %s"
+							"\n      Aborting: downloaded archives can be damaged.",
+					e.what()
+				);
+			}
+
+			// Pacman has just verified downloaded archives, and sync database tells their names.
+			for (auto& optdep : chunk) {
+				auto& archiveName = data.archiveNamesByOptDepend.at(optdep);
+				uint64_t size;
+				int64_t mtime;
+				if (auto sa = findSyncArchive(optdep);  sa != nullptr && archiveName.empty() && statArchive(sa->archiveName.sv(), size, mtime) && size == sa->size) {
+					archiveName = sa->archiveName;
+					if (ctx.verbosity >= Verbosity_Debug) {
+						ctx.log.debug(FILE_LINE "downloaded `%s` ---> `%s%s`", optdep.cp(), archivesPath.c_str(), archiveName.cp());
+					}
+				}
+			}
+			queueParseArchiveTasks();
+		}, downloadBatchSize);
+	}
+
+
+	//----------------------------------------------------------------------------------------------------------------------------------------
+
+
+	bool PacMan_Arch::statArchive(std::string_view archiveName, uint64_t& size, int64_t& mtime) {
+		struct stat st;
+		if (stat((archivesPath + std::string(archiveName)).c_str(), &st) != 0) {
+			return false;
+		}
+		size = st.st_size;
+		mtime = st.st_mtim.tv_sec * 1'000'000'000LL + st.st_mtim.tv_nsec;
+		return true;
+	}
+
+
+	// Arch packages start with metadata entries: `.PKGINFO`, `.BUILDINFO`, `.MTREE` (gzipped mtree listing of all entries, including symlinks
+	// with their targets), optional `.INSTALL` and `.CHANGELOG`. So symlinks are taken from `.MTREE`, and regular files are decided
+	// in the same pass. If `.MTREE` is missing, comes after payload, or is not understood, archive is scanned twice as before:
+	// first for symlinks, then for regular files.
+	//
+	// `.MTREE` also lists all regular files, so I know in advance which of them are needed, and stop decompressing when all of them
+	// (and `.PKGINFO`) are read. Most packages contain none or few needed libs, so often only small part of archive is decompressed.
 	void PacMan_Arch::ParseArchiveTask::impl(Package* p) {
 		ArchiveReader a(owner.archivesPath + archiveName.cp());
 
-		// Pass 1/2: all symlinks. See comments in PacMan.h.
-		a.scanAll([&](archive_entry* e) {
-			if (archive_entry_filetype(e) == AE_IFLNK) {
-				onSymlink(archive_entry_pathname(e), archive_entry_symlink(e));
+		bool isPkgInfoRead = false;
+		auto parsePkgInfo = [&](archive_entry* e) {
+			isPkgInfoRead = true;
+			auto bufAndRef = a.getEntryData(e);
+			SplitMutableString lines(bufAndRef.ref);
+			for (auto it = lines.begin();  it != lines.end();  ++it) {
+				auto sv = *it;
+				if (sv.empty() || sv.starts_with('#')) {
+					continue;
+				}
+				std::string_view key, value;
+				if (!util::parseKeyValue(sv.sv(), key, value)) {
+					throw Error(FILE_LINE "ignore `%s` / `.PKGINFO` line %d: failed to parse", archiveName.cp(), it.getPartNo());
+				}
+				util::trimInplace(value);
+				if (key == "pkgname") {
+					p->name = alloc::String{owner.ctx.mm, value};
+				} else if (key == "pkgver") {
+					p->version = alloc::String{owner.ctx.mm, value};
+				} else if (key == "provides") {
+					p->provides.insert(alloc::String{owner.ctx.mm, value});
+				}
 			}
-		});
-		onSymlinksDone();
+		};
 
-		// Pass 2/2: all regular files.
-		a.scanAll([&](archive_entry* e) {
-			auto t = archive_entry_filetype(e);
-			if (t != AE_IFREG) {
-				return;
+		// Regular files for which onFileIsNeeded() is true, but onFileContents() was not called yet; known only if `.MTREE` is parsed.
+		std::unordered_set<std::string> outstandingFiles;
+
+		// Returns false if `.MTREE` is not understood; then nothing is changed.
+		auto parseMtree = [&](archive_entry* e) {
+			std::vector<std::pair<std::string, std::string>> symlinks;
+			std::vector<std::string> files;
+			try {
+				auto bufAndRef = ArchiveReader::decompress(owner.archivesPath + archiveName.cp() + " / .MTREE", a.getEntryData(e));
+				if (!util::parseMtree(bufAndRef.ref.sr.sv(), [&](const std::string& path1, std::string_view type, const std::string& link) {
+					if (type == "link") {
+						symlinks.push_back({path1, link});
+					} else if (type == "file") {
+						files.push_back(path1);
+					}
+				})) {
+					throw Error("unsupported format");
+				}
+			} catch (std::exception& x) {
+				if (owner.ctx.verbosity >= Verbosity_Debug) {
+					owner.ctx.log.debug(FILE_LINE "read `%s`: `.MTREE` ignored: %s", archiveName.cp(), x.what());
+				}
+				return false;
 			}
+			for (auto& [path1, link] : symlinks) {
+				onSymlink(path1.c_str(), link.c_str());
+			}
+			onSymlinksDone();
+			for (auto& path1 : files) {
+				if (path1 != ".PKGINFO" && onFileIsNeeded(path1.c_str())) {
+					outstandingFiles.insert(std::move(path1));
+				}
+			}
+			return true;
+		};
 
+		enum class Stage {
+			Metadata,      // Before first payload entry.
+			SinglePass,    // Symlinks are known from `.MTREE`.
+			Symlinks       // No `.MTREE`: this pass collects symlinks, next one processes regular files.
+		};
+		Stage stage = Stage::Metadata;
+		bool isMtreeParsed = false;
+
+		auto onEntry = [&](archive_entry* e) {
+			auto t = archive_entry_filetype(e);
 			const char* path = archive_entry_pathname(e);
-			if (!strcmp(path, ".PKGINFO")) {
-				auto bufAndRef = a.getEntryData(e);
-				SplitMutableString lines(bufAndRef.ref);
-				for (auto it = lines.begin();  it != lines.end();  ++it) {
-					auto sv = *it;
-					if (sv.empty() || sv.starts_with('#')) {
-						continue;
-					}
-					std::cmatch m;
-					if (!util::regex_match(sv, m, owner.rPkginfoSWPLine)) {
-						throw Error(FILE_LINE "ignore `%s` / `.PKGINFO` line %d: failed to parse", archiveName.cp(), it.getPartNo());
-					}
-					if (m[1] == "pkgname") {
-						std::string_view m2v {m[2].first, m[2].second};
-						util::trimInplace(m2v);
-						p->name = alloc::String{owner.ctx.mm, m2v};
-					} else if (m[1] == "pkgver") {
-						std::string_view m2v {m[2].first, m[2].second};
-						util::trimInplace(m2v);
-						p->version = alloc::String{owner.ctx.mm, m2v};
-					} else if (m[1] == "provides") {
-						p->provides.insert(alloc::String{owner.ctx.mm, util::trim(m[2])});
+			if (t == AE_IFREG && !strcmp(path, ".PKGINFO")) {
+				parsePkgInfo(e);
+				return;
+			}
+			if (stage == Stage::Metadata) {
+				if (path[0] == '.' && !strchr(path, '/')) {
+					if (t == AE_IFREG && !strcmp(path, ".MTREE")) {
+						isMtreeParsed = parseMtree(e);
 					}
+					return;
+				}
+				stage = isMtreeParsed ? Stage::SinglePass : Stage::Symlinks;
+			}
+			if (stage == Stage::SinglePass) {
+				if (t == AE_IFREG && onFileIsNeeded(path)) {
+					auto bufAndRef = a.getEntryData(e);
+					onFileContents(path, bufAndRef.buf.get(), bufAndRef.ref.sr.size());
+					outstandingFiles.erase(path);
+				}
+			} else if (t == AE_IFLNK) {
+				onSymlink(path, archive_entry_symlink(e));
+			}
+		};
+		a.scanPartial([&](archive_entry* e) {
+			onEntry(e);
+			if (isMtreeParsed && isPkgInfoRead && outstandingFiles.empty()) {
+				if (owner.ctx.verbosity >= Verbosity_Debug) {
+					owner.ctx.log.debug(FILE_LINE "read `%s`: all needed entries are read, stop after `%s`", archiveName.cp(), archive_entry_pathname(e));
 				}
-			} else if (onFileIsNeeded(path)) {
+				return false;
+			}
+			return true;
+		});
+
+		if (stage == Stage::SinglePass || isMtreeParsed) {
+			return;
+		}
+		if (owner.ctx.verbosity >= Verbosity_Debug) {
+			owner.ctx.log.debug(FILE_LINE "read `%s`: no usable `.MTREE` before payload, scanning twice", archiveName.cp());
+		}
+		onSymlinksDone();
+		a.scanAll([&](archive_entry* e) {
+			const char* path = archive_entry_pathname(e);
+			if (archive_entry_filetype(e) == AE_IFREG && strcmp(path, ".PKGINFO") && onFileIsNeeded(path)) {
 				auto bufAndRef = a.getEntryData(e);
 				onFileContents(path, bufAndRef.buf.get(), bufAndRef.ref.sr.size());
 			}
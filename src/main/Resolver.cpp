@@ -1,8 +1,10 @@
+#include <bit>
 #include <libelf.h>
 #include <mutex>
 #include <optional>
 #include <sstream>
 #include "Resolver.h"
+#include "util/BufferedWriter.h"
 #include "util/Log.h"
 #include "util/ThreadPool.h"
 #include "util/util.h"
@@ -12,37 +14,69 @@
 
 namespace dimgel {
 
-	bool Resolver::execute() {
+	// Indexed by Resolver::Step.
+	static constexpr const char* stepNames[] {"absPath", "configPaths", "RPATH", "scanMoreLibs", "RUNPATH", "ldCache", "scanDefaultLibs"};
 
-		class ResolveLibsTask : public ThreadPool::Task {
-			Resolver& owner;
-			File& f;
+	// On library search order, see: `man 8 ld.so`, /notes/decisions.txt, src/etc/check-link-consistency.conf.sample.
+	template<class Search, class Skip> bool Resolver::searchSteps(const File& f, alloc::String name, Search&& search, Skip&& skip) const {
+		if (name[0] == '/') {
+			return search(Step::AbsPath, nullptr);
+		}
+		return
+			search(Step::ConfigPaths, &f.configPaths) ||
+			(f.runPaths.empty() ? search(Step::RPath, &f.rPaths) : skip(Step::RPath)) ||
+			(!f.isSecure ? search(Step::ScanMoreLibs, &ctx.scanMoreLibs) : skip(Step::ScanMoreLibs)) ||
+			search(Step::RunPath, &f.runPaths) ||
+			search(Step::LdCache, nullptr) ||
+			search(Step::ScanDefaultLibs, &ctx.scanDefaultLibs);
+	}
 
-		public:
-			ResolveLibsTask(Resolver& owner, File& f) : owner(owner), f(f) {}
 
-			void compute() override {
-				auto verbosity = owner.ctx.verbosity;
-				auto& log = owner.ctx.log;
+	bool Resolver::execute() {
 
-				auto& libs = owner.data.libs;
-				auto& ldCache = owner.data.ldCache;
+		// Resolves f->neededLibs, leaving only unresolved ones. Collects traces for explainFilePaths1 and explainLibNames.
+		auto resolveLibs = [&](std::vector<Trace>& traces, File* pf) {
+			File& f = *pf;
+			// With explainEnabled == std::false_type, all tracing code is compiled out.
+			auto impl = [&](auto explainEnabled) {
+				constexpr bool Explain = decltype(explainEnabled)::value;
+				auto verbosity = ctx.verbosity;
+				auto& log = ctx.log;
+
+				auto& libs = data.libs;
+				auto& ldCache = data.ldCache;
+				bool explainFile = Explain && ctx.explainFilePaths1.contains(f.path1);
 				for (auto it = f.neededLibs.begin();  it != f.neededLibs.end();  ) {
 					alloc::String name = *it;
+					bool explain = Explain && (explainFile || ctx.explainLibNames.contains(name));
+
+					auto trace = [&](Step step, Outcome outcome, const SearchPath* sp, File* f2) {
+						if constexpr (Explain) {
+							if (explain) {
+								traces.push_back({
+									.f = &f, .neededLib = name, .searchPath = sp, .resolvedTo = f2,
+									.step = step, .outcome = outcome, .pass = (uint8_t)numPasses
+								});
+							}
+						}
+					};
 
 					// ATTENTION!!! When called with ldCache, both `map` keys and `path1` are .so names (not paths).
-					auto searchOne = [&](const char* description, PathAndBitnessMap& map, StringRef path1) -> bool {
-						auto it2 = map.find(std::pair{path1, f.is32});
-						if (it2 == map.end()) {
+					auto searchOne = [&](Step step, const FrozenPathAndBitnessMap& map, StringRef path1, const SearchPath* sp = nullptr) -> bool {
+						const char* description = stepNames[(int)step];
+						File* f2 = map.find(path1, f.is32);
+						if (f2 == nullptr) {
+							trace(step, Outcome::NotFound, sp, nullptr);
 							return false;
 						}
-						File* f2 = it2->second;
 						if (f2 == &f) {
+							trace(step, Outcome::ResolvedToItself, sp, f2);
 							log.error(FILE_LINE "`/%s`: ignored needed lib `%s` ---> resolved to itself", f.path1.cp(), name.cp());
 							it = f.neededLibs.erase(it);
 							return true;
 						}
 						if (!f2->isDynamicELF || !f2->isLib) {
+							trace(step, Outcome::NotALibrary, sp, f2);
 							log.error(
 								FILE_LINE "`/%s`: ignored needed lib `%s` ---> `/%s` (%s): not a %s",
 								f.path1.cp(), name.cp(), f2->path1.cp(), description, (f2->isDynamicELF ? "library" : "dynamic ELF")
@@ -50,6 +84,7 @@ namespace dimgel {
 							it = f.neededLibs.erase(it);
 							return true;
 						}
+						trace(step, Outcome::Resolved, sp, f2);
 						if (verbosity >= Verbosity_Debug) {
 							log.debug(FILE_LINE "`/%s`: resolved needed lib `%s` ---> `/%s` (%s)", f.path1.cp(), name.cp(), f2->path1.cp(), description);
 						}
@@ -57,29 +92,29 @@ namespace dimgel {
 						return true;
 					};
 
-					auto searchPaths = [&](const char* searchPathsDescription, const std::vector<SearchPath>& searchPaths, alloc::String fileName) -> bool {
+					auto searchPaths = [&](Step step, const std::vector<SearchPath>& searchPaths, alloc::String fileName) -> bool {
 						for (auto& sp : searchPaths) {
 							char buf[PATH_MAX];
-							if (searchOne(searchPathsDescription, libs, util::concatStringViews(buf, sizeof(buf), {sp.path1.sv(), "/", fileName.sv()}))) {
+							if (searchOne(step, libs, util::concatStringViews(buf, sizeof(buf), {sp.path1.sv(), "/", fileName.sv()}), &sp)) {
 								return true;
 							}
 						}
 						return false;
 					};
 
-					// On library search order, see: `man 8 ld.so`, /notes/decisions.txt, src/etc/check-link-consistency.conf.sample.
-					if (name[0] == '/') {
-						if (searchOne("absPath", libs, name.substr(1))) {
-							continue;
+					auto skipped = [&](Step step) {
+						trace(step, Outcome::Skipped, nullptr, nullptr);
+						return false;
+					};
+
+					auto search = [&](Step step, const std::vector<SearchPath>* sps) {
+						switch (step) {
+							case Step::AbsPath: return searchOne(step, libs, name.substr(1));
+							case Step::LdCache: return searchOne(step, ldCache, name);
+							default:            return searchPaths(step, *sps, name);
 						}
-					} else if (
-						searchPaths("configPaths", f.configPaths, name) ||
-						(f.runPaths.empty() && searchPaths("RPATH", f.rPaths, name)) ||
-						(!f.isSecure && searchPaths("scanMoreLibs", owner.ctx.scanMoreLibs, name)) ||
-						searchPaths("RUNPATH", f.runPaths, name) ||
-						searchOne("ldCache", ldCache, name) ||
-						searchPaths("scanDefaultLibs", owner.ctx.scanDefaultLibs, name)
-					) {
+					};
+					if (searchSteps(f, name, search, skipped)) {
 						continue;
 					}
 
@@ -88,35 +123,42 @@ namespace dimgel {
 					}
 					++it;
 				} // for (auto it = f.neededLibs.begin();  ...)
-			} // void compute()
-
+			}; // impl()
 
-			void merge() override {
+			if (ctx.explainFilePaths1.empty() && ctx.explainLibNames.empty()) {
+				impl(std::false_type{});
+			} else {
+				impl(std::true_type{});
 			}
-		}; // class ResolveLibsTask
+		}; // resolveLibs()
 
 
 		if (ctx.verbosity >= Verbosity_Default) {
 			ctx.log.info("Resolving libs...");
 		}
+		numPasses++;
 		data.unresolvedNeededLibNames.reserve(150);
 
 		// Remove files containing nothing to resolve.
 		// Resolve neededLibs.
 		{
-			std::vector<std::unique_ptr<ThreadPool::Task>> tasks;
-			tasks.reserve(data.uniqueFilesByPath1.size());
+			std::vector<File*> files;
+			files.reserve(data.uniqueFilesByPath1.size());
 			for (auto it = data.uniqueFilesByPath1.begin();  it != data.uniqueFilesByPath1.end();  ) {
 				File* f = it->second;
 				// f->isDymamicELF maybe false if ELFInspector::processOne_impl() threw internally; but f->neededLibs may already be filled.
 				if (f->isDynamicELF && !f->neededLibs.empty()) {
-					tasks.push_back(std::make_unique<ResolveLibsTask>(*this, *f));
+					files.push_back(f);
 					++it;
 				} else {
 					it = data.uniqueFilesByPath1.erase(it);
 				}
 			}
-			ctx.threadPool.addTasks(ctx.threadPool.groupTasks(std::move(tasks)));
+			ctx.threadPool.parallelReduce<std::vector<Trace>>(
+				std::span(files), resolveLibs,
+				[](std::vector<Trace>& into, std::vector<Trace>& from) { into.insert(into.end(), from.begin(), from.end()); },
+				[&](std::vector<Trace>& t) { traces.insert(traces.end(), t.begin(), t.end()); }
+			);
 			ctx.threadPool.waitAll();
 		}
 
@@ -132,6 +174,15 @@ namespace dimgel {
 				it++;
 			}
 		}
+		data.unresolvedNeededLibNamesFilter = BloomFilter(data.unresolvedNeededLibNames.size());
+		data.unresolvedNeededLibNamesByPath1.clear();
+		for (auto& nl : data.unresolvedNeededLibNames) {
+			if (nl[0] == '/') {
+				data.unresolvedNeededLibNamesByPath1.insert({nl.substr(1), nl});
+			} else {
+				data.unresolvedNeededLibNamesFilter.add(nl.sv());
+			}
+		}
 
 		if (ctx.verbosity >= Verbosity_Debug) {
 			ctx.log.debug(FILE_LINE "stats: data.uniqueFilesByPath1.size() = %lu", ulong{data.uniqueFilesByPath1.size()});
@@ -147,6 +198,11 @@ namespace dimgel {
 
 	// Would take 0.25s instead of 0.33s (with -SO options) if I haven't used std::iostream here.
 	void Resolver::dumpErrors() {
+		if (ctx.outputFormat != OutputFormat::Text) {
+			dumpErrors_stream();
+			return;
+		}
+
 		constexpr StringRef titleP {"Package"};
 		constexpr StringRef titleF {"Problematic File"};
 		constexpr StringRef titleNL {"Unresolved Needed Libs"};
@@ -299,4 +355,166 @@ namespace dimgel {
 			line2();
 		}
 	} // dumpErrors()
+
+
+	//----------------------------------------------------------------------------------------------------------------------------------------
+
+
+	// NDJSON: one object per (file, unresolved needed lib):
+	//     {"package":"gcc","version":"11.1.0-1","file":"/usr/lib/x.so","bits":64,"lib":"libfoo.so","searched":["RUNPATH","ldCache","scanDefaultLibs"]}
+	//     For unassigned files, "package" and "version" are null.
+	//
+	// Binary: header "CLC\x01", then same records, each is:
+	//     u32 recordLength (not including itself), u8 flags (bit 0: is32, bit 1: has package), u8 searched (bit mask of 1 << Resolver::Step),
+	//     then 4 strings: package, version, file (absolute path), lib; each string is u16 length + bytes, not null-terminated.
+	//     All integers are little-endian.
+	void Resolver::dumpErrors_stream() {
+		BufferedWriter w(STDOUT_FILENO, 1024 * 1024);
+		bool json = ctx.outputFormat == OutputFormat::NDJSON;
+
+		// Steps which actually looked something up for unresolved lib: not skipped, and with non-empty search paths list.
+		auto searchedMask = [&](const File& f, alloc::String name) {
+			unsigned m = 0;
+			searchSteps(
+				f, name,
+				[&](Step step, const std::vector<SearchPath>* sps) {
+					if (sps == nullptr || !sps->empty()) {
+						m |= 1u << (int)step;
+					}
+					return false;
+				},
+				[](Step) { return false; }
+			);
+			return m;
+		};
+
+		// Param `pfx` is written inside quotes as is.
+		auto jsonString = [&](std::string_view s, std::string_view pfx = "") {
+			w.put('"');
+			w.write(pfx);
+			for (char c : s) {
+				if (c == '"' || c == '\\') {
+					w.put('\\');
+					w.put(c);
+				} else if ((unsigned char)c < 0x20) {
+					char buf[8];
+					snprintf(buf, sizeof(buf), "\\u%04x", (unsigned)c);
+					w.write(buf);
+				} else {
+					w.put(c);
+				}
+			}
+			w.put('"');
+		};
+
+		auto binaryString = [&](std::string_view s) {
+			uint16_t n = s.size();
+			w.write(&n, sizeof(n));
+			w.write(s);
+		};
+
+		static_assert(std::endian::native == std::endian::little);
+		if (!json) {
+			w.write("CLC\x01");
+		}
+
+		for (auto [_, f] : data.uniqueFilesByPath1) {
+			Package* p = f->belongsToPackage;
+			for (auto name : f->neededLibs) {
+				unsigned searched = searchedMask(*f, name);
+				if (json) {
+					w.write("{\"package\":");
+					if (p != nullptr) { jsonString(p->name.sv()); } else { w.write("null"); }
+					w.write(",\"version\":");
+					if (p != nullptr) { jsonString(p->version.sv()); } else { w.write("null"); }
+					w.write(",\"file\":");
+					jsonString(f->path1.sv(), "/");
+					w.write(f->is32 ? ",\"bits\":32,\"lib\":" : ",\"bits\":64,\"lib\":");
+					jsonString(name.sv());
+					w.write(",\"searched\":[");
+					bool first = true;
+					for (int i = 0;  i < (int)std::size(stepNames);  i++) {
+						if (searched & (1u << i)) {
+							if (!first) { w.put(','); }
+							first = false;
+							jsonString(stepNames[i]);
+						}
+					}
+					w.write("]}\n");
+				} else {
+					std::string_view pName = p != nullptr ? p->name.sv() : "";
+					std::string_view pVersion = p != nullptr ? p->version.sv() : "";
+					uint32_t length = 2 + (2 + pName.size()) + (2 + pVersion.size()) + (2 + 1 + f->path1.size()) + (2 + name.size());
+					w.write(&length, sizeof(length));
+					w.put((char)((f->is32 ? 1 : 0) | (p != nullptr ? 2 : 0)));
+					w.put((char)searched);
+					binaryString(pName);
+					binaryString(pVersion);
+					uint16_t n = 1 + f->path1.size();
+					w.write(&n, sizeof(n));
+					w.put('/');
+					w.write(f->path1.sv());
+					binaryString(name.sv());
+				}
+			}
+		}
+
+		w.flush();
+	}
+
+
+	//----------------------------------------------------------------------------------------------------------------------------------------
+
+
+	void Resolver::dumpExplain() {
+		static constexpr const char* outcomeNames[] {"not found", "resolved", "resolved to itself", "not a library", "skipped"};
+
+		// Group by file and needed lib, keeping lookup order inside group.
+		std::stable_sort(traces.begin(), traces.end(), [](const Trace& a, const Trace& b) {
+			if (auto x = a.f->path1 <=> b.f->path1;  x != 0) { return x < 0; }
+			if (auto x = a.neededLib <=> b.neededLib;  x != 0) { return x < 0; }
+			return a.pass < b.pass;
+		});
+
+		alloc::StringHashSet explainedFilePaths1;
+		alloc::StringHashSet explainedLibNames;
+		const Trace* prev = nullptr;
+		for (auto& t : traces) {
+			if (prev == nullptr || prev->f != t.f || prev->neededLib != t.neededLib || prev->pass != t.pass) {
+				ctx.log.info(
+					"Explain: `/%s`%s needs `%s` (pass %d):",
+					t.f->path1.cp(), (t.f->is32 ? " (32-bit)" : ""), t.neededLib.cp(), int{t.pass}
+				);
+			}
+			prev = &t;
+			explainedFilePaths1.insert(t.f->path1);
+			explainedLibNames.insert(t.neededLib);
+
+			char where[PATH_MAX + 2];
+			if (t.searchPath != nullptr) {
+				snprintf(where, sizeof(where), "`/%s`", t.searchPath->path1.cp());
+			} else {
+				where[0] = '\0';
+			}
+			if (t.resolvedTo != nullptr) {
+				ctx.log.info(
+					"    %-15s %s ---> `/%s`: %s",
+					stepNames[(int)t.step], where, t.resolvedTo->path1.cp(), outcomeNames[(int)t.outcome]
+				);
+			} else {
+				ctx.log.info("    %-15s %s%s%s", stepNames[(int)t.step], where, (where[0] ? ": " : ""), outcomeNames[(int)t.outcome]);
+			}
+		}
+
+		for (auto& s : ctx.explainFilePaths1) {
+			if (!explainedFilePaths1.contains(s)) {
+				ctx.log.info("Explain: `/%s`: nothing to explain: not found, not a dynamic ELF, or has no needed libs", s.cp());
+			}
+		}
+		for (auto& s : ctx.explainLibNames) {
+			if (!explainedLibNames.contains(s) && (s[0] != '/' || !explainedFilePaths1.contains(s.substr(1)))) {
+				ctx.log.info("Explain: `%s`: nothing to explain: not needed by any dynamic ELF", s.cp());
+			}
+		}
+	}
 }
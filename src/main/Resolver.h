@@ -6,8 +6,51 @@
 namespace dimgel {
 
 	class Resolver {
+	public:
+		// Library search steps in the order they are tried, see resolveLibs() in Resolver::execute().
+		enum class Step : uint8_t {
+			AbsPath,
+			ConfigPaths,
+			RPath,
+			ScanMoreLibs,
+			RunPath,
+			LdCache,
+			ScanDefaultLibs
+		};
+
+		enum class Outcome : uint8_t {
+			NotFound,
+			Resolved,
+			ResolvedToItself,
+			NotALibrary,
+			Skipped   // E.g. RPATH is ignored if RUNPATH is present, scanMoreLibs (LD_LIBRARY_PATH) is ignored for secure files.
+		};
+
+		// Compact record of single lookup, collected only for ctx.explain* targets. Rendered by dumpExplain().
+		struct Trace {
+			File* f;
+			alloc::String neededLib;
+			const SearchPath* searchPath;   // nullptr for AbsPath, LdCache and skipped steps.
+			File* resolvedTo;               // nullptr unless outcome != NotFound.
+			Step step;
+			Outcome outcome;
+			uint8_t pass;                   // 1-based execute() call number.
+		};
+
+	private:
 		Context& ctx;
 		Data& data;
+		int numPasses = 0;
+		std::vector<Trace> traces;
+
+		// Library search order for needed lib `name` of file `f`, shared by execute() and dumpErrors_stream() so reports match lookups.
+		// Calls search(step, searchPaths) for each step, where searchPaths is nullptr for AbsPath and LdCache, and skip(step) for steps ignored
+		// for this file. Stops and returns true as soon as either returns true.
+		template<class Search, class Skip> bool searchSteps(const File& f, alloc::String name, Search&& search, Skip&& skip) const;
+
+		// For OutputFormat::NDJSON and OutputFormat::Binary: streams records without sorting, through single BufferedWriter.
+		// Called even if all OK: then NDJSON is empty, and Binary is just header.
+		void dumpErrors_stream();
 
 	public:
 		Resolver(Context& ctx, Data& data) : ctx(ctx), data(data) {}
@@ -16,5 +59,8 @@ namespace dimgel {
 		bool execute();
 
 		void dumpErrors();
+
+		// Prints traces collected by all execute() calls, for files and needed libs listed in ctx.explainFilePaths1 and ctx.explainLibNames.
+		void dumpExplain();
 	};
 }
@@ -0,0 +1,42 @@
+#include <bit>
+#include "data.h"
+
+
+namespace dimgel {
+
+	void FrozenPathAndBitnessMap::freeze() {
+		if (overflow.empty()) {
+			return;
+		}
+
+		// Load factor <= 0.5 keeps linear probe sequences short.
+		size_t n = numEntries + overflow.size();
+		size_t capacity = std::bit_ceil(n * 2);
+		auto newEntries = std::make_unique<Entry[]>(capacity);
+		size_t newMask = capacity - 1;
+
+		auto add = [&](alloc::String path1, bool is32, File* f) {
+			auto h = hashAndIs32(path1.sv(), is32);
+			size_t i = (h >> 1) & newMask;
+			while (newEntries[i].f != nullptr) {
+				i = (i + 1) & newMask;
+			}
+			newEntries[i] = Entry{.hashAndIs32 = h, .path1 = path1, .f = f};
+		};
+		for (size_t i = 0;  i <= mask && numEntries > 0;  i++) {
+			auto& e = entries[i];
+			if (e.f != nullptr) {
+				add(e.path1, e.hashAndIs32 & 1, e.f);
+			}
+		}
+		for (auto& [k, f] : overflow) {
+			add(k.path1, k.is32, f);
+		}
+
+		entries = std::move(newEntries);
+		mask = newMask;
+		numEntries = n;
+		// clear() keeps buckets array allocated.
+		PathAndBitnessMap{}.swap(overflow);
+	}
+}
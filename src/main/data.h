@@ -2,11 +2,14 @@
 
 #include <atomic>
 #include <dirent.h>
+#include <memory>
 #include <optional>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
+#include "util/BloomFilter.h"
+#include "util/FrontCodedStringMap.h"
 #include "util/alloc/MemoryManager.h"
 #include "util/alloc/String.h"
 
@@ -57,9 +60,80 @@ namespace dimgel {
 		return a.path1 == b.first && a.is32 == b.second;
 	}
 
+	class File;
+
 	using PathAndBitnessMap = std::unordered_map<PathAndBitnessKey, class File*, std::hash<PathAndBitnessKey>, std::equal_to<>>;
 
 
+	// Filled like PathAndBitnessMap, then freeze() moves all entries into flat open-addressing table which is probed by Resolver:
+	// for ~20K libs it's 1-2 cache lines per lookup instead of bucket + node + key string, and no allocations.
+	// Entries added after freeze() (by PacMan, from optional dependencies) go to small `overflow` map which is probed second.
+	//
+	// NOT thread-safe for writes; find() may be called in parallel as long as nobody writes.
+	class FrozenPathAndBitnessMap final {
+		// Bit 0 of `hashAndIs32` is PathAndBitnessKey::is32, other bits are from path1 hash.
+		// Empty slot has f == nullptr.
+		struct Entry {
+			size_t hashAndIs32;
+			alloc::String path1;
+			File* f;
+		};
+		static_assert(sizeof(Entry) == 32);
+
+		std::unique_ptr<Entry[]> entries;
+		size_t mask = 0;   // Capacity - 1, capacity is power of 2.
+		size_t numEntries = 0;
+		PathAndBitnessMap overflow;
+
+		static size_t hashAndIs32(std::string_view path1, bool is32) noexcept {
+			return (std::hash<std::string_view>{}(path1) & ~size_t{1}) | size_t{is32};
+		}
+
+		File* findFrozen(std::string_view path1, bool is32) const noexcept {
+			if (numEntries == 0) {
+				return nullptr;
+			}
+			auto h = hashAndIs32(path1, is32);
+			for (size_t i = (h >> 1) & mask;  ;  i = (i + 1) & mask) {
+				const Entry& e = entries[i];
+				if (e.f == nullptr) {
+					return nullptr;
+				}
+				if (e.hashAndIs32 == h && e.path1.sv() == path1) {
+					return e.f;
+				}
+			}
+		}
+
+	public:
+		void reserve(size_t n) { overflow.reserve(n); }
+		size_t size() const noexcept { return numEntries + overflow.size(); }
+
+		// Returns {value in map, true if inserted}; like std::unordered_map::insert() but with value instead of iterator.
+		std::pair<File*, bool> insert(const PathAndBitnessKey& k, File* f) {
+			if (File* f0 = findFrozen(k.path1.sv(), k.is32)) {
+				return {f0, false};
+			}
+			auto [it, inserted] = overflow.insert({k, f});
+			return {it->second, inserted};
+		}
+
+		File* find(StringRef path1, bool is32) const {
+			if (File* f = findFrozen(path1.sv(), is32)) {
+				return f;
+			}
+			if (overflow.empty()) {
+				return nullptr;
+			}
+			auto it = overflow.find(std::pair{path1, is32});
+			return it != overflow.end() ? it->second : nullptr;
+		}
+
+		// Moves all `overflow` entries (i.e. everything inserted so far) into frozen table. May be called multiple times.
+		void freeze();
+	};
+
+
 	//----------------------------------------------------------------------------------------------------------------------------------------
 
 
@@ -84,6 +158,13 @@ namespace dimgel {
 		ino_t inode;
 	};
 
+	// How Resolver::dumpErrors() outputs problematic files.
+	enum class OutputFormat {
+		Text,     // Human-readable table (or list if !Context::wideOutput), to stderr.
+		NDJSON,   // One JSON object per unresolved needed lib, to stdout.
+		Binary    // Length-prefixed records, to stdout; see Resolver::dumpErrors_stream().
+	};
+
 	// Common configs & dependencies for controllers.
 	struct Context final {
 
@@ -91,10 +172,12 @@ namespace dimgel {
 
 		int verbosity;
 		bool wideOutput;
+		OutputFormat outputFormat;
 		bool colorize;
 		struct Colors& colors;
 		bool useOptionalDeps;
 		bool noNetwork;
+		bool lazyOwnership;   // See PacMan::loadInstalledPackagesFiles().
 
 		std::vector<SearchPath>& scanBins;          // defaults_*.hpp/scanDefaultBins + .conf/scanMoreBins
 		std::vector<SearchPath>& scanDefaultLibs;   // defaults_*.hpp/scanDefaultLibs
@@ -103,6 +186,10 @@ namespace dimgel {
 		alloc::StringHashMap<std::vector<AddLibPath>>& addLibPathsByFilePath1Prefix;        // .conf/addLibPath
 		std::unordered_map<class Package*, std::vector<AddLibPath>> addLibPathsByPackage;   // .conf/addLibPath
 
+		// Command line `--explain` targets. If both are empty, Resolver does not trace anything.
+		alloc::StringHashSet& explainFilePaths1;   // Realpaths of explained files, without leading '/'.
+		alloc::StringHashSet& explainLibNames;     // Explained needed lib names (or absolute paths, like in File::neededLibs).
+
 
 		// Dependencies:
 
@@ -181,22 +268,23 @@ namespace dimgel {
 		// Used by PacMan::calculateOptionalDependencies() to filter out already installed dependencies.
 		alloc::StringHashMap<Package*> packagesByProvides;
 
-		// Filled by PacMan::parseInstalledPackages().
+		// Filled by PacMan::parseInstalledPackages(), or in lazy ownership mode by PacMan::loadInstalledPackagesFiles() with few packages only.
 		// Used by FileCollector to assign File.belongsToPackage.
 		// Key = file realpath1 belonging to package. Multiple files may belong to same package.
-		alloc::StringHashMap<Package*> packagesByFilePath1;
+		// Contains only paths passing PacMan::isOwnedFileRelevant(); still ~100K paths sharing long prefixes, hence front-coded.
+		FrontCodedStringMap<Package*> packagesByFilePath1;
 
 		// Files to be analyzed by Resolver. Filled by FilesCollector, successfully resolved files are removed by Resolver.
 		// Key = canonical file path, key == value->path1. Needed to process (by ELFInspector, Resolver) each file only once.
 		alloc::StringHashMap<File*> uniqueFilesByPath1;
 
-		// Searched by Resolver. Filled by FilesCollector and PacMan.
+		// Searched by Resolver. Filled by FilesCollector and frozen at the end of FilesCollector::execute(); PacMan adds to overflow.
 		// Key = canonical or symlink path1. Multiple keys may reference same File.
-		PathAndBitnessMap libs;
+		FrozenPathAndBitnessMap libs;
 
-		// Searched by Resolver. Filled by FilesCollector.
+		// Searched by Resolver. Filled and frozen by FilesCollector.
 		// Key = .so name, not path.
-		PathAndBitnessMap ldCache;
+		FrozenPathAndBitnessMap ldCache;
 
 		// Filled by Resolver.
 		//
@@ -208,6 +296,12 @@ namespace dimgel {
 		// Key = neededLib name without '/', or absolute path with leading '/' (see how ELFInspector fills File::neededLibs) that was not found on system.
 		alloc::StringHashSet unresolvedNeededLibNames;
 
+		// Rebuilt by Resolver along with unresolvedNeededLibNames, for PacMan::findUnresolvedNeededLib() which is called for every file
+		// of every candidate package and mostly misses: Bloom filter over keys without '/', and keys with leading '/' mapped by
+		// path without it (there are usually none), so archive paths are looked up as they are, without copying.
+		BloomFilter unresolvedNeededLibNamesFilter;
+		alloc::StringHashMap<alloc::String> unresolvedNeededLibNamesByPath1;
+
 		// Filled by PacMan::assignProblematicFilesToInstalledPackages().
 		// Used by PacMan::downloadOptionalDependencies() and PacMan::processOptionalDependencies().
 		// Key = non-installed optional dependency (package name or virtual dependency).
@@ -1,3 +1,4 @@
+#include <getopt.h>
 #include <regex>
 #include <string.h>
 #include <unistd.h>
@@ -39,13 +40,21 @@ int main(int argc, char* argv[]) {
 	bool ctx_wideOutput = true;
 	bool ctx_useOptionalDeps = true;
 	bool ctx_noNetwork = false;
+	bool ctx_lazyOwnership = false;
 	bool ctx_colorize = true;
 	Colors* ctx_colors = &Colors::enabled;
+	OutputFormat ctx_outputFormat = OutputFormat::Text;
+	std::vector<std::string> explainTargets;
 	{
+		static constinit option longOptions[] {
+			{"explain", required_argument, nullptr, 'e'},
+			{"format", required_argument, nullptr, 'f'},
+			{nullptr, 0, nullptr, 0}
+		};
 		bool ok = true;
 		int opt;
 		opterr = false;
-		while (ok && (opt = getopt(argc, argv, "qvONWC")) != -1) {
+		while (ok && (opt = getopt_long(argc, argv, "qvONLWCe:f:", longOptions, nullptr)) != -1) {
 			switch (opt) {
 				case 'q': {
 					ctx_verbosity = Verbosity_Quiet;
@@ -64,6 +73,10 @@ int main(int argc, char* argv[]) {
 					ctx_noNetwork = true;
 					break;
 				}
+				case 'L': {
+					ctx_lazyOwnership = true;
+					break;
+				}
 				case 'W': {
 					ctx_wideOutput = false;
 					break;
@@ -73,6 +86,22 @@ int main(int argc, char* argv[]) {
 					ctx_colors = &Colors::disabled;
 					break;
 				}
+				case 'e': {
+					explainTargets.push_back(optarg);
+					break;
+				}
+				case 'f': {
+					if (!strcmp(optarg, "text")) {
+						ctx_outputFormat = OutputFormat::Text;
+					} else if (!strcmp(optarg, "ndjson")) {
+						ctx_outputFormat = OutputFormat::NDJSON;
+					} else if (!strcmp(optarg, "binary")) {
+						ctx_outputFormat = OutputFormat::Binary;
+					} else {
+						ok = false;
+					}
+					break;
+				}
 				default: {
 					ok = false;
 				}
@@ -87,8 +116,16 @@ int main(int argc, char* argv[]) {
 					"    -O  = Don't download & analyze optional dependencies\n"
 					"    -N  = No network: pretend optional dependencies are already downloaded;\n"
 					"          bypass `pacman -Sw` but otherwise process optdeps as usual\n"
+					"    -L  = Lazy package ownership: read installed packages' file lists only for packages\n"
+					"          referenced by addLibPath, and for problematic files (skips duplicate owners check)\n"
 					"    -W  = Disable wide output, use machine-readable format\n"
 					"    -C  = Don't colorize output\n"
+					"    -e, --explain={/file/path|libName}\n"
+					"        = Show library search sequence for all needed libs of file /file/path (absolute),\n"
+					"          or for needed lib libName of all files; may be specified multiple times\n"
+					"    -f, --format={text|ndjson|binary}\n"
+					"        = Output format of problematic files list; default is text (see also -W).\n"
+					"          ndjson and binary are written to stdout (INFO and DEBG messages go to stderr then)\n"
 					"Status codes:\n"
 					"     0  = system is consistent :)\n"
 					"     1  = not consistent :(\n"
@@ -100,7 +137,7 @@ int main(int argc, char* argv[]) {
 		}
 	}
 
-	Log ctx_log(*ctx_colors);
+	Log ctx_log(*ctx_colors, ctx_outputFormat == OutputFormat::Text ? STDOUT_FILENO : STDERR_FILENO);
 
 
 	try {
@@ -120,6 +157,20 @@ int main(int argc, char* argv[]) {
 		alloc::StringHashMap<std::vector<AddLibPath>> ctx_addLibPathsByPackageName;
 		std::unordered_map<std::string, std::vector<AddOptDepend>> ctx_addOptDependsByPackageName;
 		std::unordered_map<std::string, std::vector<RemoveOptDepend>> ctx_removeOptDependsByPackageName;
+		alloc::StringHashSet ctx_explainFilePaths1;
+		alloc::StringHashSet ctx_explainLibNames;
+
+		for (auto& target : explainTargets) {
+			if (target.empty()) {
+				throw Error("Command line: invalid --explain target: empty");
+			}
+			ctx_explainLibNames.insert(alloc::String{ctx_mm, target});
+			if (target[0] == '/') {
+				// Also file path; or needed lib's absolute path, matched as is.
+				char path0[PATH_MAX];
+				ctx_explainFilePaths1.insert(alloc::String{ctx_mm, (util::realPath(target.c_str(), path0) ? path0 : target.c_str()) + 1});
+			}
+		}
 
 		{
 			// See /notes/decisions.txt.
@@ -213,8 +264,6 @@ int main(int argc, char* argv[]) {
 						(ctx_log.*f)("Reading config file: `%s`...", path.c_str());
 					}
 					auto contents = util::readFile(path.c_str());
-					std::regex rAddLib{"^\\s*(\\S+)\\s+(\\S+)\\s*$"};
-					std::regex& rAddOptDepend = rAddLib;
 					IniParser::execute(contents.ref, [&](const IniParser::Line& l) {
 
 						auto scanMore = [&](std::vector<SearchPath>& target) {
@@ -224,12 +273,12 @@ int main(int argc, char* argv[]) {
 						};
 
 						auto parseAddLibPath = [&]() {
-							std::cmatch m;
-							if (!util::regex_match(l.value(), m, rAddLib)) {
+							std::string_view m1, m2;
+							if (!util::parseTwoWords(l.value().sv(), m1, m2)) {
 								throw Error("Config line %d: bad %s: invalid syntax", l.lineNo(), l.key().cp());
 							}
-							std::string where = m[1];   // Where to add (package | /file/path | /directory/**).
-							std::string what = m[2];    // What to add (/lib/path | /search/path).
+							std::string where {m1};   // Where to add (package | /file/path | /directory/**).
+							std::string what {m2};    // What to add (/lib/path | /search/path).
 
 							if (what[0] != '/') {
 								throw Error("Config line %d: bad %s: `%s` must be absolute path", l.lineNo(), l.key().cp(), what.c_str());
@@ -336,12 +385,12 @@ int main(int argc, char* argv[]) {
 						} else if (l.key() == "addOptDepend" || l.key() == "removeOptDepend") {
 							bool add = l.key().starts_with('a');
 
-							std::cmatch m;
-							if (!util::regex_match(l.value(), m, rAddOptDepend)) {
+							std::string_view m1, m2;
+							if (!util::parseTwoWords(l.value().sv(), m1, m2)) {
 								throw Error("Config line %d: bad %s: invalid syntax", l.lineNo(), l.key().cp());
 							}
-							std::string package = m[1];
-							std::string optdep = m[2];
+							std::string package {m1};
+							std::string optdep {m2};
 							if (package.find('/') != std::string::npos) {
 								throw Error("Config line %d: bad %s: package name `%s` contains '/'", l.lineNo(), l.key().cp(), package.c_str());
 							}
@@ -399,10 +448,12 @@ int main(int argc, char* argv[]) {
 		Context ctx {
 			.verbosity = ctx_verbosity,
 			.wideOutput = ctx_wideOutput,
+			.outputFormat = ctx_outputFormat,
 			.colorize = ctx_colorize,
 			.colors = *ctx_colors,
 			.useOptionalDeps = ctx_useOptionalDeps,
 			.noNetwork = ctx_noNetwork,
+			.lazyOwnership = ctx_lazyOwnership,
 
 			.scanBins = ctx_scanBins,
 			.scanDefaultLibs = ctx_scanDefaultLibs,
@@ -410,6 +461,8 @@ int main(int argc, char* argv[]) {
 			.ignoreFiles = ctx_ignoreFiles,
 			.addLibPathsByFilePath1Prefix = ctx_addLibPathsByFilePath1Prefix,
 			.addLibPathsByPackage {},
+			.explainFilePaths1 = ctx_explainFilePaths1,
+			.explainLibNames = ctx_explainLibNames,
 
 			.log = ctx_log,
 			.threadPool = ctx_threadPool,
@@ -426,9 +479,16 @@ int main(int argc, char* argv[]) {
 		Resolver soResolver(ctx, data);
 		auto pacman = createPacMan(ctx, data, elfInspector);
 
+		auto debugOutputThreadPoolStats = [&](const char* phaseName) {
+			if (ctx.verbosity >= Verbosity_Debug) {
+				ctx.threadPool.debugOutputStats(ctx.log, phaseName);
+			}
+		};
+
 		auto ok = [&]{
 			// Config file will contain package-specific lib paths. So to simplify everything, load packages first.
 			pacman->parseInstalledPackages();
+			debugOutputThreadPoolStats("parseInstalledPackages()");
 
 			// Some configuration checks / transformations.
 			ctx.addLibPathsByPackage.reserve(ctx_addLibPathsByPackageName.size());
@@ -490,12 +550,23 @@ int main(int argc, char* argv[]) {
 			ctx_addLibPathsByPackageName.clear();
 			ctx_addOptDependsByPackageName.clear();
 			ctx_removeOptDependsByPackageName.clear();
+			{
+				std::vector<Package*> packages;
+				for (auto& [p, _] : ctx.addLibPathsByPackage) {
+					packages.push_back(p);
+				}
+				pacman->loadInstalledPackagesFiles(packages);
+			}
 
 			// ...Let's go on.
 			filesCollector.execute();
-			if (soResolver.execute()) {
+			debugOutputThreadPoolStats("FilesCollector::execute()");
+			bool resolved = soResolver.execute();
+			debugOutputThreadPoolStats("Resolver::execute()");
+			if (resolved) {
 				return true;
 			}
+			pacman->assignUnresolvedFiles();
 			if (!ctx.useOptionalDeps) {
 				return false;
 			}
@@ -507,15 +578,23 @@ int main(int argc, char* argv[]) {
 
 			pacman->downloadOptionalDependencies();
 			pacman->processOptionalDependencies();
-			return soResolver.execute();
+			debugOutputThreadPoolStats("processOptionalDependencies()");
+			resolved = soResolver.execute();
+			debugOutputThreadPoolStats("Resolver::execute()");
+			return resolved;
 		}();
 
 		if (ctx.verbosity >= Verbosity_Debug) {
 			ctx.mm.debugOutputStats(ctx.log, "ctx.mm");
 		}
-		if (!ok) {
+		if (!ctx.explainFilePaths1.empty() || !ctx.explainLibNames.empty()) {
+			soResolver.dumpExplain();
+		}
+		// Machine-readable output is written even if it has no records: binary header tells "consistent" from "truncated or crashed".
+		if (!ok || ctx.outputFormat != OutputFormat::Text) {
 			soResolver.dumpErrors();
-		} else if (ctx.verbosity >= Verbosity_Default) {
+		}
+		if (ok && ctx.verbosity >= Verbosity_Default) {
 			ctx.log.info("All good. :)");
 		}
 
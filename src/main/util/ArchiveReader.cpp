@@ -1,7 +1,11 @@
 #include <archive.h>
 #include <archive_entry.h>
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <vector>
 #include "ArchiveReader.h"
+#include "Closeable.h"
 #include "Error.h"
 #include "Finally.h"
 #include "util.h"
@@ -11,23 +15,36 @@
 
 namespace dimgel {
 
-	ArchiveReader::ArchiveReader(std::string path_)
-		: path(std::move(path_)),
-		  fd {::open(path.c_str(), O_RDONLY)}
-	{
+	ArchiveReader::ArchiveReader(std::string path_) : path(std::move(path_)) {
+		Closeable fd {::open(path.c_str(), O_RDONLY)};
 		if (fd == -1) {
 			throw Error(FILE_LINE "`%s`: open() failed: %s", path.c_str(), strerror(errno));
 		}
+		struct stat st;
+		if (fstat(fd, &st) == -1) {
+			throw Error(FILE_LINE "`%s`: fstat() failed: %s", path.c_str(), strerror(errno));
+		}
+		if (st.st_size == 0) {
+			throw Error(FILE_LINE "`%s`: file is empty", path.c_str());
+		}
+		// Readahead hint for page cache misses (cold run), and for mapping too: pages are touched once, front to back.
+		posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+		void* m = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (m == MAP_FAILED) {
+			throw Error(FILE_LINE "`%s`: mmap() failed: %s", path.c_str(), strerror(errno));
+		}
+		madvise(m, st.st_size, MADV_SEQUENTIAL);
+		mapping = m;
+		mappingSize = st.st_size;
 	}
 
 
-	void ArchiveReader::scanPartial(std::function<bool(archive_entry*)> onEntry) {
-		// Otherwise 2nd scan won't work:
-		if (alreadyScanned && lseek(fd, 0, SEEK_SET) == -1) {
-			throw Error(FILE_LINE "`%s`: lseek() failed: %s", path.c_str(), strerror(errno));
-		}
-		alreadyScanned = true;
+	ArchiveReader::~ArchiveReader() {
+		munmap(mapping, mappingSize);
+	}
+
 
+	void ArchiveReader::scanPartial(std::function<bool(archive_entry*)> onEntry) {
 		if (a != nullptr) {
 			throw Error(FILE_LINE "`%s`: already inside scan()", path.c_str());
 		}
@@ -39,8 +56,8 @@ namespace dimgel {
 
 		archive_read_support_filter_all(a);
 		archive_read_support_format_all(a);
-		if (archive_read_open_fd(a, fd, 10240) != ARCHIVE_OK) {
-			throw Error(FILE_LINE "`%s`: archive_read_open_fd() failed: %s", path.c_str(), archive_error_string(a));
+		if (archive_read_open_memory(a, mapping, mappingSize) != ARCHIVE_OK) {
+			throw Error(FILE_LINE "`%s`: archive_read_open_memory() failed: %s", path.c_str(), archive_error_string(a));
 		}
 
 		archive_entry* e;
@@ -83,4 +100,39 @@ namespace dimgel {
 
 		return {.buf {std::move(buf)}, .ref {StringRef::createUnsafe(s, (size_t)ssize)}};
 	}
+
+
+	BufAndRef ArchiveReader::decompress(const std::string& path, const BufAndRef& compressed) {
+		archive* a = archive_read_new();
+		Finally aFin([&]{
+			archive_read_free(a);
+		});
+
+		archive_read_support_filter_all(a);
+		archive_read_support_format_raw(a);
+		archive_entry* e;
+		if (archive_read_open_memory(a, compressed.buf.get(), compressed.ref.sr.size()) != ARCHIVE_OK || archive_read_next_header(a, &e) != ARCHIVE_OK) {
+			throw Error(FILE_LINE "`%s`: archive_read_open_memory() failed: %s", path.c_str(), archive_error_string(a));
+		}
+
+		// Uncompressed size is unknown.
+		std::vector<char> v;
+		char chunk[65536];
+		while (true) {
+			auto n = archive_read_data(a, chunk, sizeof(chunk));
+			if (n < 0) {
+				throw Error(FILE_LINE "`%s`: archive_read_data() failed: %s", path.c_str(), archive_error_string(a));
+			}
+			if (n == 0) {
+				break;
+			}
+			v.insert(v.end(), chunk, chunk + n);
+		}
+
+		auto buf = std::make_unique<char[]>(v.size() + 1);
+		char* s = buf.get();
+		memcpy(s, v.data(), v.size());
+		s[v.size()] = '\0';
+		return {.buf {std::move(buf)}, .ref {StringRef::createUnsafe(s, v.size())}};
+	}
 }
@@ -3,7 +3,6 @@
 #include <functional>
 #include <memory>
 #include "BufAndRef.h"
-#include "Closeable.h"
 
 struct archive;
 struct archive_entry;
@@ -12,14 +11,18 @@ struct archive_entry;
 namespace dimgel {
 
 	// https://github.com/libarchive/libarchive/wiki/Examples
+	//
+	// Archive file is mmap()-ed and given to libarchive as single memory block, instead of archive_read_open_fd() with 10 KiB blocks:
+	// that was thousands of read() syscalls per archive, per scan. Repeated scans don't need lseek() either.
 	class ArchiveReader final {
 		std::string path;
-		Closeable fd;
+		void* mapping = nullptr;
+		size_t mappingSize = 0;
 		archive* a = nullptr;
-		bool alreadyScanned = false;
 
 	public:
 		ArchiveReader(std::string path_);
+		~ArchiveReader();
 
 		ArchiveReader(const ArchiveReader&) = delete;
 		ArchiveReader(ArchiveReader&&) = delete;
@@ -38,5 +41,8 @@ namespace dimgel {
 		}
 
 		BufAndRef getEntryData(archive_entry* e);
+
+		// Decompresses data which is compressed but not archived, e.g. gzipped `.MTREE` entry of Arch package. Param `path` is for error messages.
+		static BufAndRef decompress(const std::string& path, const BufAndRef& compressed);
 	};
 }
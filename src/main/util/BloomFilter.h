@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <stdint.h>
+#include <string_view>
+#include <vector>
+
+
+namespace dimgel {
+
+	// Blocked Bloom filter over strings, for cheap rejection of lookups that mostly miss.
+	//
+	// All bits of a key are set within single 64-byte block, so mayContain() hashes key once and reads one cache line.
+	// With bitsPerKey = 16, false positive rate is about 0.1%; there are no false negatives.
+	// Default-constructed filter contains nothing and cannot be added to; construct with expected number of keys instead.
+	//
+	// Built by add() on single thread, then mayContain() may be called in parallel.
+	class BloomFilter final {
+		struct alignas(64) Block {
+			uint64_t words[8];
+		};
+		static constexpr int numHashes = 6;   // Bit positions are 9-bit slices of single 64-bit value.
+
+		std::vector<Block> blocks;
+
+		// Block index is taken from high half of hash (multiply-shift instead of modulo),
+		// bit positions from its remix (splitmix64 finalizer), so they don't correlate.
+		const Block& block(uint64_t h) const noexcept { return blocks[((h >> 32) * blocks.size()) >> 32]; }
+
+		static uint64_t remix(uint64_t h) noexcept {
+			h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9;
+			h = (h ^ (h >> 27)) * 0x94D049BB133111EB;
+			return h ^ (h >> 31);
+		}
+
+	public:
+		BloomFilter() = default;
+		explicit BloomFilter(size_t numKeys, size_t bitsPerKey = 16) : blocks(std::max<size_t>(1, (numKeys * bitsPerKey + 511) / 512), Block{}) {}
+
+		void add(std::string_view key) noexcept {
+			uint64_t h = std::hash<std::string_view>{}(key);
+			auto& b = const_cast<Block&>(block(h));
+			uint64_t m = remix(h);
+			for (int i = 0;  i < numHashes;  i++, m >>= 9) {
+				b.words[(m >> 6) & 7] |= uint64_t{1} << (m & 63);
+			}
+		}
+
+		bool mayContain(std::string_view key) const noexcept {
+			if (blocks.empty()) {
+				return false;
+			}
+			uint64_t h = std::hash<std::string_view>{}(key);
+			auto& b = block(h);
+			uint64_t m = remix(h);
+			for (int i = 0;  i < numHashes;  i++, m >>= 9) {
+				if (!(b.words[(m >> 6) & 7] & (uint64_t{1} << (m & 63)))) {
+					return false;
+				}
+			}
+			return true;
+		}
+	};
+}
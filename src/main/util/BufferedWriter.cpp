@@ -0,0 +1,59 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include "BufferedWriter.h"
+#include "Error.h"
+#include "util.h"
+
+#define FILE_LINE "BufferedWriter:" LINE ": "
+
+
+namespace dimgel {
+
+	BufferedWriter::BufferedWriter(int fd, size_t capacity) : fd(fd), capacity(capacity), buf(std::make_unique<char[]>(capacity)) {
+		if (capacity == 0) {
+			throw std::runtime_error(FILE_LINE "BufferedWriter(): capacity == 0");
+		}
+	}
+
+
+	BufferedWriter::~BufferedWriter() {
+		try {
+			flush();
+		} catch (...) {
+			// Nothing we can do.
+		}
+	}
+
+
+	void BufferedWriter::write(const void* data, size_t n) {
+		auto p = reinterpret_cast<const char*>(data);
+		while (n > 0) {
+			if (size == capacity) {
+				flush();
+			}
+			size_t k = std::min(n, capacity - size);
+			memcpy(buf.get() + size, p, k);
+			size += k;
+			p += k;
+			n -= k;
+		}
+	}
+
+
+	void BufferedWriter::flush() {
+		const char* p = buf.get();
+		while (size > 0) {
+			auto x = ::write(fd, p, size);
+			if (x < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				size = 0;
+				throw Error(FILE_LINE "write() failed: %s", strerror(errno));
+			}
+			p += x;
+			size -= x;
+		}
+	}
+}
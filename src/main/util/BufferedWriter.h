@@ -0,0 +1,38 @@
+#pragma once
+
+#include <memory>
+#include <string_view>
+
+
+namespace dimgel {
+
+	// Accumulates output in large buffer and write()-s it in big chunks; for output which is too large to go through Log one line per syscall.
+	// Not thread-safe.
+	class BufferedWriter final {
+		int fd;
+		size_t capacity;
+		size_t size = 0;
+		std::unique_ptr<char[]> buf;
+
+	public:
+		BufferedWriter(int fd, size_t capacity = 65536);
+
+		BufferedWriter(const BufferedWriter&) = delete;
+		BufferedWriter& operator =(const BufferedWriter&) = delete;
+
+		// Flushes, ignoring errors. Call flush() explicitly to get them.
+		~BufferedWriter();
+
+		void write(const void* data, size_t n);
+		void write(std::string_view s) { write(s.data(), s.size()); }
+		void put(char c) {
+			if (size == capacity) {
+				flush();
+			}
+			buf[size++] = c;
+		}
+
+		// Throws on write() errors.
+		void flush();
+	};
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Error.h"
+
+
+namespace dimgel {
+
+	// Immutable sorted map with front-coded keys, for large sets of strings sharing long prefixes (e.g. file paths).
+	//
+	// Keys are split into blocks of up to `blockSize`; first key of each block is stored in full, others as
+	// (length of prefix shared with previous key, suffix). Sparse index `blockOffsets` is binary-searched by blocks' first keys,
+	// then block is scanned sequentially without reconstructing keys (see find()).
+	//
+	// Built by Builder from keys added in strictly ascending order, or by concat() of maps built in parallel for adjacent key ranges.
+	// find() may be called in parallel.
+	template<class V> class FrontCodedStringMap final {
+		static constexpr size_t blockSize = 16;
+
+		std::vector<char> bytes;
+		std::vector<uint32_t> blockOffsets;
+		// Index in `values` of each block's first key; last block of each concat() part may be shorter than blockSize.
+		std::vector<uint32_t> blockFirstValues;
+		std::vector<V> values;
+
+		static void putVarint(std::vector<char>& out, size_t x) {
+			while (x >= 0x80) {
+				out.push_back((char)(x | 0x80));
+				x >>= 7;
+			}
+			out.push_back((char)x);
+		}
+
+		static size_t getVarint(const char*& p) noexcept {
+			size_t x = 0;
+			for (int shift = 0;  ;  shift += 7) {
+				auto b = (unsigned char)*p++;
+				x |= size_t(b & 0x7F) << shift;
+				if (!(b & 0x80)) {
+					return x;
+				}
+			}
+		}
+
+		std::string_view blockFirstKey(size_t iBlock) const noexcept {
+			const char* p = bytes.data() + blockOffsets[iBlock];
+			getVarint(p);   // shared == 0
+			size_t length = getVarint(p);
+			return {p, length};
+		}
+
+		// Index of last block whose first key is <= `key`, or -1 if all blocks' first keys are greater.
+		ptrdiff_t findBlock(std::string_view key) const noexcept {
+			size_t lo = 0, hi = blockOffsets.size();
+			while (lo < hi) {
+				size_t mid = (lo + hi) / 2;
+				if (blockFirstKey(mid) <= key) {
+					lo = mid + 1;
+				} else {
+					hi = mid;
+				}
+			}
+			return (ptrdiff_t)lo - 1;
+		}
+
+	public:
+		class Builder final {
+			FrontCodedStringMap m;
+			std::string prevKey;
+
+		public:
+			void reserve(size_t numKeys, size_t numBytes) {
+				m.bytes.reserve(numBytes);
+				m.blockOffsets.reserve(numKeys / blockSize + 1);
+				m.blockFirstValues.reserve(numKeys / blockSize + 1);
+				m.values.reserve(numKeys);
+			}
+
+			// Keys must be added in strictly ascending order; it's caller's responsibility to check for duplicates.
+			void add(std::string_view key, V value) {
+				if (!m.values.empty() && key <= prevKey) {
+					throw Error("FrontCodedStringMap::Builder: keys are not in ascending order: `%s` after `%s`", std::string(key).c_str(), prevKey.c_str());
+				}
+				size_t shared = 0;
+				if (m.values.size() % blockSize == 0) {
+					m.blockOffsets.push_back((uint32_t)m.bytes.size());
+					m.blockFirstValues.push_back((uint32_t)m.values.size());
+				} else {
+					shared = std::mismatch(key.begin(), key.end(), prevKey.begin(), prevKey.end()).first - key.begin();
+				}
+				putVarint(m.bytes, shared);
+				putVarint(m.bytes, key.length() - shared);
+				m.bytes.insert(m.bytes.end(), key.begin() + shared, key.end());
+				m.values.push_back(std::move(value));
+				prevKey = key;
+			}
+
+			FrontCodedStringMap build() {
+				m.bytes.shrink_to_fit();
+				m.blockOffsets.shrink_to_fit();
+				m.blockFirstValues.shrink_to_fit();
+				m.values.shrink_to_fit();
+				prevKey.clear();
+				return std::move(m);
+			}
+		};
+
+
+		// All keys of parts[i] must be less than all keys of parts[i + 1]; it's caller's responsibility to check.
+		static FrontCodedStringMap concat(std::vector<FrontCodedStringMap> parts) {
+			FrontCodedStringMap m;
+			size_t numBytes = 0, numBlocks = 0, numValues = 0;
+			for (auto& p : parts) {
+				numBytes += p.bytes.size();
+				numBlocks += p.blockOffsets.size();
+				numValues += p.values.size();
+			}
+			m.bytes.reserve(numBytes);
+			m.blockOffsets.reserve(numBlocks);
+			m.blockFirstValues.reserve(numBlocks);
+			m.values.reserve(numValues);
+			for (auto& p : parts) {
+				auto bytesBase = (uint32_t)m.bytes.size();
+				auto valuesBase = (uint32_t)m.values.size();
+				m.bytes.insert(m.bytes.end(), p.bytes.begin(), p.bytes.end());
+				for (size_t i = 0;  i < p.blockOffsets.size();  i++) {
+					m.blockOffsets.push_back(bytesBase + p.blockOffsets[i]);
+					m.blockFirstValues.push_back(valuesBase + p.blockFirstValues[i]);
+				}
+				std::move(p.values.begin(), p.values.end(), std::back_inserter(m.values));
+				p = {};
+			}
+			return m;
+		}
+
+
+		size_t size() const noexcept { return values.size(); }
+
+		// Approximate heap usage, for statistics.
+		size_t memoryUsage() const noexcept {
+			return bytes.capacity() + (blockOffsets.capacity() + blockFirstValues.capacity()) * sizeof(uint32_t) + values.capacity() * sizeof(V);
+		}
+
+		// Returns nullptr if not found.
+		const V* find(std::string_view key) const noexcept {
+			ptrdiff_t iBlock = findBlock(key);
+			if (iBlock < 0) {
+				return nullptr;
+			}
+			size_t iValue = blockFirstValues[iBlock];
+			size_t iEnd = (size_t)iBlock + 1 < blockFirstValues.size() ? blockFirstValues[iBlock + 1] : values.size();
+			const char* p = bytes.data() + blockOffsets[iBlock];
+
+			// Invariant: previous key < `key`, and they share `matched` leading chars.
+			// Next key sharing more than `matched` chars with previous one is also < `key`; sharing less is > `key`.
+			size_t matched = 0;
+			for (;  iValue < iEnd;  iValue++) {
+				size_t shared = getVarint(p);
+				size_t length = getVarint(p);
+				const char* suffix = p;
+				p += length;
+				if (shared > matched) {
+					continue;
+				}
+				if (shared < matched) {
+					return nullptr;
+				}
+				std::string_view rest = key.substr(matched);
+				std::string_view s {suffix, length};
+				size_t n = std::mismatch(rest.begin(), rest.end(), s.begin(), s.end()).first - rest.begin();
+				if (n == rest.length() && n == s.length()) {
+					return &values[iValue];
+				}
+				if (n == rest.length() || (n < s.length() && (unsigned char)s[n] > (unsigned char)rest[n])) {
+					// Current key is greater than `key`.
+					return nullptr;
+				}
+				matched += n;
+			}
+			return nullptr;
+		}
+	};
+}
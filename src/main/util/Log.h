@@ -11,6 +11,9 @@ namespace dimgel {
 	class Log final {
 		const Colors& colors;
 
+		// Where DEBG and INFO messages go. It's stderr if stdout is used for machine-readable output.
+		int debugAndInfoFd;
+
 		// ATTENTION! All these must be 4 chars length, it's hardcoded in impl().
 		static constexpr const char* pfxDEBG = "DEBG";
 		static constexpr const char* pfxINFO = "INFO";
@@ -21,13 +24,13 @@ namespace dimgel {
 		void impl(int fd, const char*, StringRef color, const char* format, va_list args);
 
 	public:
-		Log(const Colors& colors) : colors(colors) {}
+		Log(const Colors& colors, int debugAndInfoFd = STDOUT_FILENO) : colors(colors), debugAndInfoFd(debugAndInfoFd) {}
 
 		// __attribute__(): format arg is 2 because arg 1 is `this`.
 		void debug(const char* format, ...) noexcept __attribute__((format(printf, 2, 3))) {
 			va_list args;
 			va_start(args, format);
-			impl(STDOUT_FILENO, pfxDEBG, colors.blue, format, args);
+			impl(debugAndInfoFd, pfxDEBG, colors.blue, format, args);
 
 			// This satisfies cppcheck, but if impl() throws: https://stackoverflow.com/q/11645282/4247442
 			va_end(args);
@@ -36,7 +39,7 @@ namespace dimgel {
 		void info(const char* format, ...) noexcept __attribute__((format(printf, 2, 3))) {
 			va_list args;
 			va_start(args, format);
-			impl(STDOUT_FILENO, pfxINFO, colors.green, format, args);
+			impl(debugAndInfoFd, pfxINFO, colors.green, format, args);
 			va_end(args);
 		}
 
@@ -0,0 +1,179 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <linux/limits.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Closeable.h"
+#include "Error.h"
+#include "MappedCacheFile.h"
+#include "util.h"
+
+#define FILE_LINE "MappedCacheFile:" LINE ": "
+
+
+namespace dimgel {
+
+	void MappedCacheFile::Reader::throwUnexpectedEnd() {
+		throw Error(FILE_LINE "malformed cache: unexpected end of record");
+	}
+
+
+	void MappedCacheFile::Reader::list(std::vector<std::string_view>& target) {
+		auto n = get<uint32_t>();
+		target.clear();
+		target.reserve(n);
+		for (uint32_t i = 0;  i < n;  i++) {
+			target.push_back(str());
+		}
+	}
+
+
+	void MappedCacheFile::Reader::beginRecord() {
+		const char* start = p;
+		auto recordSize = get<uint32_t>();
+		if (recordSize < sizeof(uint32_t) || (size_t)(end - start) < recordSize) {
+			throw Error(FILE_LINE "malformed cache: bad record size");
+		}
+		end = start + recordSize;
+	}
+
+
+	const char* MappedCacheFile::Reader::endRecord(std::string_view key) {
+		if (p != end) {
+			throw Error(FILE_LINE "malformed cache: record `%.*s` size mismatch", (int)key.length(), key.data());
+		}
+		return end;
+	}
+
+
+	//----------------------------------------------------------------------------------------------------------------------------------------
+
+
+	size_t MappedCacheFile::Writer::strSize(std::string_view s) {
+		if (s.length() > UINT16_MAX) {
+			throw Error(FILE_LINE "save(): string is too long: `%.*s...`", 100, s.data());
+		}
+		return sizeof(uint16_t) + s.length();
+	}
+
+
+	size_t MappedCacheFile::Writer::listSize(const std::vector<std::string_view>& v) {
+		size_t n = sizeof(uint32_t);
+		for (auto s : v) {
+			n += strSize(s);
+		}
+		return n;
+	}
+
+
+	uint32_t MappedCacheFile::Writer::recordSize(size_t n, std::string_view key) {
+		if (n > UINT32_MAX) {
+			throw Error(FILE_LINE "save(): record `%.*s` is too large", (int)key.length(), key.data());
+		}
+		return (uint32_t)n;
+	}
+
+
+	void MappedCacheFile::Writer::list(const std::vector<std::string_view>& v) {
+		put((uint32_t)v.size());
+		for (auto s : v) {
+			str(s);
+		}
+	}
+
+
+	void MappedCacheFile::Writer::zeros(size_t n) {
+		for (;  n > 0;  n--) {
+			w.put('\0');
+		}
+	}
+
+
+	//----------------------------------------------------------------------------------------------------------------------------------------
+
+
+	bool MappedCacheFile::load(const char* path, const HeaderPrefix& prefix, size_t headerSize) {
+		unload();
+
+		Closeable fd {open(path, O_RDONLY)};
+		if (fd < 0) {
+			if (errno == ENOENT) {
+				return false;
+			}
+			throw Error(FILE_LINE "load(`%s`): open() failed: %s", path, strerror(errno));
+		}
+		struct stat st;
+		if (fstat(fd, &st) < 0) {
+			throw Error(FILE_LINE "load(`%s`): fstat() failed: %s", path, strerror(errno));
+		}
+		if ((size_t)st.st_size < headerSize) {
+			throw Error(FILE_LINE "load(`%s`): malformed cache: file is too short", path);
+		}
+		void* m = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (m == MAP_FAILED) {
+			throw Error(FILE_LINE "load(`%s`): mmap() failed: %s", path, strerror(errno));
+		}
+		mapping = m;
+		mappingSize = st.st_size;
+
+		HeaderPrefix p;
+		memcpy(&p, begin(), sizeof(p));
+		if (memcmp(p.magic, prefix.magic, sizeof(p.magic)) != 0) {
+			unload();
+			throw Error(FILE_LINE "load(`%s`): not a cache file", path);
+		}
+		if (p.formatVersion != prefix.formatVersion) {
+			unload();
+			throw Error(FILE_LINE "load(`%s`): format version %u, expected %u", path, p.formatVersion, prefix.formatVersion);
+		}
+		return true;
+	}
+
+
+	void MappedCacheFile::unload() {
+		if (mapping != nullptr) {
+			munmap(mapping, mappingSize);
+			mapping = nullptr;
+			mappingSize = 0;
+		}
+	}
+
+
+	void MappedCacheFile::save(const char* path, const std::function<void(Writer& w)>& write) {
+		{
+			char dirBuf[PATH_MAX];
+			strncpy(dirBuf, path, sizeof(dirBuf) - 1);
+			dirBuf[sizeof(dirBuf) - 1] = '\0';
+			const char* dir = dirname(dirBuf);
+			if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+				throw Error(FILE_LINE "save(): mkdir(`%s`) failed: %s", dir, strerror(errno));
+			}
+		}
+
+		// Unique name: concurrent runs must not write into the same temporary file.
+		std::string tmpPath = std::string(path) + ".XXXXXX";
+		Closeable fd {mkstemp(tmpPath.data())};
+		if (fd < 0) {
+			throw Error(FILE_LINE "save(): mkstemp(`%s`) failed: %s", tmpPath.c_str(), strerror(errno));
+		}
+		try {
+			if (fchmod(fd, 0644) < 0) {
+				throw Error(FILE_LINE "save(): fchmod(`%s`) failed: %s", tmpPath.c_str(), strerror(errno));
+			}
+			{
+				Writer w(fd);
+				write(w);
+				w.flush();
+			}
+			if (rename(tmpPath.c_str(), path) < 0) {
+				throw Error(FILE_LINE "save(): rename(`%s`) failed: %s", tmpPath.c_str(), strerror(errno));
+			}
+		} catch (...) {
+			unlink(tmpPath.c_str());
+			throw;
+		}
+	}
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <functional>
+#include <stdint.h>
+#include <string.h>
+#include <string_view>
+#include <vector>
+#include "BufferedWriter.h"
+
+
+namespace dimgel {
+
+	// Common part of persistent caches which are written once as a whole and mmap()-ed on load: InstalledPackagesCache, OptDependsArchivesCache.
+	// File layout (native byte order, it's local cache): cache-specific header starting with HeaderPrefix, then records and whatever else cache needs.
+	// Record = u32 recordSize (including itself) + fields, where str = u16 length + chars (no terminator), list = u32 count + str[count].
+	class MappedCacheFile final {
+	public:
+		struct HeaderPrefix {
+			char magic[8];
+			uint32_t formatVersion;
+		};
+
+		// Bounds-checked sequential reader over mapping.
+		class Reader {
+			const char* p;
+			const char* end;
+
+			[[noreturn]] static void throwUnexpectedEnd();
+
+			void need(size_t n) {
+				if ((size_t)(end - p) < n) {
+					throwUnexpectedEnd();
+				}
+			}
+
+		public:
+			Reader(const char* p, const char* end) : p(p), end(end) {}
+
+			template<class T> T get() {
+				need(sizeof(T));
+				T x;
+				memcpy(&x, p, sizeof(T));
+				p += sizeof(T);
+				return x;
+			}
+
+			std::string_view str() {
+				auto n = get<uint16_t>();
+				need(n);
+				std::string_view s {p, n};
+				p += n;
+				return s;
+			}
+
+			void list(std::vector<std::string_view>& target);
+
+			// Reads recordSize and limits reader to the record.
+			void beginRecord();
+			// Throws if record is not read up to its end exactly, `key` is for error message. Returns pointer past record end.
+			const char* endRecord(std::string_view key);
+		};
+
+		// Writes what Reader reads. Static *Size() methods compute sizes of the same fields for recordSize and header; they throw if field is too large.
+		class Writer {
+			BufferedWriter w;
+
+		public:
+			Writer(int fd) : w(fd, 1024*1024) {}
+
+			static size_t strSize(std::string_view s);
+			static size_t listSize(const std::vector<std::string_view>& v);
+			static uint32_t recordSize(size_t n, std::string_view key);
+
+			template<class T> void put(const T& x) { w.write(&x, sizeof(x)); }
+			void str(std::string_view s) { put((uint16_t)s.length());  w.write(s); }
+			void list(const std::vector<std::string_view>& v);
+			void zeros(size_t n);
+			void flush() { w.flush(); }
+		};
+
+	private:
+		void* mapping = nullptr;
+		size_t mappingSize = 0;
+
+	public:
+		MappedCacheFile() = default;
+		MappedCacheFile(const MappedCacheFile&) = delete;
+		MappedCacheFile& operator =(const MappedCacheFile&) = delete;
+		~MappedCacheFile() { unload(); }
+
+		// Returns false if file does not exist. Throws if it's shorter than `headerSize`, or its HeaderPrefix differs from `prefix`; file is not mapped then.
+		bool load(const char* path, const HeaderPrefix& prefix, size_t headerSize);
+		void unload();
+
+		const char* begin() const noexcept { return reinterpret_cast<const char*>(mapping); }
+		const char* end() const noexcept { return begin() + mappingSize; }
+		size_t size() const noexcept { return mappingSize; }
+
+		// Calls `write` to write the whole file into uniquely named temporary file next to `path`, then renames it over `path`:
+		// concurrent runs never see partially written cache, and last writer wins as a whole. Temporary file is removed on any error.
+		// Creates parent directory if it does not exist.
+		static void save(const char* path, const std::function<void(Writer& w)>& write);
+	};
+}
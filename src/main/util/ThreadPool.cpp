@@ -1,7 +1,9 @@
+#include <chrono>
 #include <optional>
 #include <mutex>
 #include <unistd.h>
 #include "Abort.h"
+#include "Log.h"
 #include "ThreadPool.h"
 #include "util.h"
 
@@ -30,6 +32,102 @@ namespace dimgel {
 	}
 
 
+	ThreadPool::GuidedRange::GuidedRange(size_t size, size_t numThreads, size_t numSlots)
+		: size(size), numThreads(numThreads), slots(std::make_unique<std::atomic<uint64_t>[]>(numSlots)), numSlots(numSlots)
+	{
+		if (size > UINT32_MAX) {
+			throw std::runtime_error(FILE_LINE "GuidedRange(): too many tasks");
+		}
+		for (size_t i = 0;  i < numSlots;  i++) {
+			slots[i] = 0;
+		}
+	}
+
+
+	bool ThreadPool::GuidedRange::takeOne(size_t iSlot, size_t& i) noexcept {
+		auto& slot = slots[iSlot];
+		uint64_t x = slot.load();
+		while (true) {
+			uint32_t b = x >> 32, e = (uint32_t)x;
+			if (b >= e) {
+				return false;
+			}
+			if (slot.compare_exchange_weak(x, (uint64_t)(b + 1) << 32 | e)) {
+				i = b;
+				return true;
+			}
+		}
+	}
+
+
+	bool ThreadPool::GuidedRange::claim(size_t iSlot) noexcept {
+		size_t b = next.load(std::memory_order_relaxed);
+		while (b < size) {
+			size_t e = b + std::max<size_t>(1, (size - b) / (2 * numThreads));
+			if (next.compare_exchange_weak(b, e, std::memory_order_relaxed)) {
+				slots[iSlot] = (uint64_t)b << 32 | e;
+				return true;
+			}
+		}
+		return false;
+	}
+
+
+	bool ThreadPool::GuidedRange::steal(size_t iSlot) noexcept {
+		while (true) {
+			// Victim with most tasks left; its owner is busy with long task or is about to take next one.
+			size_t iVictim = 0;
+			uint64_t x = 0;
+			uint32_t maxLeft = 0;
+			for (size_t j = 0;  j < numSlots;  j++) {
+				uint64_t y = slots[j].load();
+				uint32_t left = (uint32_t)y - std::min((uint32_t)y, (uint32_t)(y >> 32));
+				if (left > maxLeft) {
+					iVictim = j;
+					x = y;
+					maxLeft = left;
+				}
+			}
+			if (maxLeft == 0) {
+				return false;
+			}
+			// Upper half, rounded up: single task left is stolen too, owner will find its slot empty.
+			uint32_t b = x >> 32, e = (uint32_t)x, mid = b + maxLeft / 2;
+			if (slots[iVictim].compare_exchange_strong(x, (uint64_t)b << 32 | mid)) {
+				slots[iSlot] = (uint64_t)mid << 32 | e;
+				return true;
+			}
+		}
+	}
+
+
+	void ThreadPool::GuidedGroup::compute() {
+		size_t i;
+		while (!owner.stopping && range->take(iSlot, i)) {
+			if (!runs.empty() && runs.back().second == i) {
+				runs.back().second++;
+			} else {
+				runs.push_back({i, i + 1});
+			}
+			range->tasks[i]->compute();
+		}
+	}
+
+
+	void ThreadPool::GuidedGroup::merge() {
+		// Different groups touch disjoint elements of range->tasks, so reset() is safe; vector itself is deleted with last group.
+		for (auto [begin, end] : runs) {
+			for (size_t i = begin;  i < end;  i++) {
+				if (owner.stopping) {
+					return;
+				}
+				range->tasks[i]->merge();
+				range->tasks[i].reset();
+			}
+		}
+	}
+
+
 	//----------------------------------------------------------------------------------------------------------------------------------------
 
 
@@ -40,65 +138,56 @@ namespace dimgel {
 			int numCPUs = sysconf(_SC_NPROCESSORS_ONLN);
 			numThreads = std::max(1, numCPUs - -numThreads);
 		}
-		numBusyThreads = numThreads;
+		workers = std::make_unique<Worker[]>(numThreads);
 		threads.reserve(numThreads);
-		while (--numThreads >= 0) {
-			threads.push_back(std::thread(&threadFunction, this));
+		for (int i = 0;  i < numThreads;  i++) {
+			threads.push_back(std::thread(&threadFunction, this, (size_t)i));
 		}
 	}
 
 
-	void ThreadPool::threadFunction(ThreadPool* self) {
-		self->threadMethod();
+	void ThreadPool::threadFunction(ThreadPool* self, size_t iWorker) {
+		self->threadMethod(iWorker);
 	}
 
 
-	void ThreadPool::threadMethod() {
-		std::unique_ptr<Task> currentTask;
-		bool computeThrew = false;
+	std::unique_ptr<ThreadPool::Task> ThreadPool::takeTask(size_t iWorker) {
+		size_t n = threads.size();
+		for (size_t i = 0;  i < n;  i++) {
+			auto& w = workers[(iWorker + i) % n];
+			std::lock_guard g(w.lock);
+			if (!w.tasks.empty()) {
+				auto t = std::move(w.tasks.front());
+				w.tasks.pop_front();
+				numQueuedTasks--;
+				return t;
+			}
+		}
+		return nullptr;
+	}
+
 
+	void ThreadPool::threadMethod(size_t iWorker) {
 		while (true) {
-			{
-				std::unique_lock l(m);
+			auto currentTask = takeTask(iWorker);
 
-				// Finish previous task under lock.
-				if (computeThrew) {
-					computeThrew = false;
-				} else if (currentTask) {
-					try {
-						// Calling merge() only if compute() didn't throw, i.e. if currentTaskException_opt was empty.
-						currentTask->merge();
-					} catch (Abort& e) {
-						processTaskException("", true);
-					} catch (std::exception& e) {
-						processTaskException(e.what(), false);
-					}
+			if (!currentTask) {
+				std::unique_lock l(m);
+				if (numQueuedTasks > 0) {
+					// Some addTasks() is in progress, or task was just stolen from under my nose. Retry.
+					l.unlock();
+					std::this_thread::yield();
+					continue;
 				}
-				currentTask.reset();
-				numBusyThreads--;
-
-				// Get new task, stop, or wait.
-				while (true) {
-					if (!queue.empty()) {
-						numBusyThreads++;
-						currentTask = std::move(queue.front());
-						queue.pop();
-						break;
-					}
-					if (state != State::ACTIVE) {
-						if (numBusyThreads == 0) {
-							cvMain.notify_one();
-						}
-						if (state == State::DESTRUCTING) {
-							return;
-						}
-					}
-					cvWorker.wait(l);
+				if (state == State::DESTRUCTING && numPendingTasks == 0) {
+					return;
 				}
+				cvWorker.wait(l);
+				continue;
 			}
 
 			// Execute task.
-			// We are outside mutex now, so store exception for future processing.
+			bool computeThrew = false;
 			try {
 				currentTask->compute();
 			} catch (Abort& e) {
@@ -108,6 +197,30 @@ namespace dimgel {
 				computeThrew = true;
 				processTaskException(e.what(), false);
 			}
+
+			// Calling merge() only if compute() didn't throw.
+			if (!computeThrew) {
+				auto t0 = std::chrono::steady_clock::now();
+				std::lock_guard g(mergeMutex);
+				auto t1 = std::chrono::steady_clock::now();
+				try {
+					currentTask->merge();
+				} catch (Abort& e) {
+					processTaskException("", true);
+				} catch (std::exception& e) {
+					processTaskException(e.what(), false);
+				}
+				numMerges++;
+				mergeWaitDuration += (t1 - t0).count();
+				mergeDuration += (std::chrono::steady_clock::now() - t1).count();
+			}
+			currentTask.reset();
+
+			if (--numPendingTasks == 0) {
+				// Taking mutex so that waitAll_impl() cannot miss notification between its check and cvMain.wait().
+				std::lock_guard g(m);
+				cvMain.notify_one();
+			}
 		}
 	}
 
@@ -126,17 +239,22 @@ namespace dimgel {
 
 
 	std::vector<std::unique_ptr<ThreadPool::Task>> ThreadPool::groupTasks(std::vector<std::unique_ptr<Task>> tasks, int numTasksPerGroup) const {
-		if (numTasksPerGroup == 0) {
-			// Just to be explicit.
-			throw std::runtime_error(FILE_LINE "groupTasks(): numTasksPerGroup == 0");
-		}
-
 		std::vector<std::unique_ptr<ThreadPool::Task>> result;
 		int numTasks = (int)tasks.size();
 		if (numTasks == 0) {
 			return result;
 		}
 
+		if (numTasksPerGroup == Guided) {
+			int numGroups = std::min(numTasks, getNumThreads());
+			auto range = std::make_shared<GuidedTasks>(std::move(tasks), (size_t)getNumThreads(), (size_t)numGroups);
+			result.reserve(numGroups);
+			for (int i = 0;  i < numGroups;  i++) {
+				result.push_back(std::make_unique<GuidedGroup>(*this, range, (size_t)i));
+			}
+			return result;
+		}
+
 		int numGroups = (numTasksPerGroup > 0)
 				// numTasks > 0, numTasksPerGroup > 0 ---> numGroups > 0, numGroups * numTasksPerGroup <= numTasks.
 				? (numTasks + numTasksPerGroup - 1) / numTasksPerGroup
@@ -180,19 +298,28 @@ namespace dimgel {
 		if (tasks.empty()) {
 			return;
 		}
-		bool notifyOne;
+		if (state != State::ACTIVE) {
+			throw std::runtime_error(FILE_LINE "addTasks(): state != ACTIVE");
+		}
+
+		// Round-robin, so each deque keeps submission order and idle workers steal from the front.
+		numPendingTasks += tasks.size();
+		numQueuedTasks += tasks.size();
+		size_t n = threads.size();
+		for (auto& t : tasks) {
+			auto& w = workers[nextWorker];
+			nextWorker = (nextWorker + 1) % n;
+			std::lock_guard g(w.lock);
+			w.tasks.push_back(std::move(t));
+		}
+
+		// Worker decides to sleep under mutex after checking numQueuedTasks; taking mutex here guarantees it either saw my increment,
+		// or is already waiting on cvWorker and receives notification.
 		{
-			std::unique_lock l(m);
-			if (state != State::ACTIVE) {
-				throw std::runtime_error(FILE_LINE "addTasks(): state != ACTIVE");
-			}
-			for (auto& t : tasks) {
-				queue.push(std::move(t));
-			}
-			notifyOne = queue.size() == 1;
+			std::lock_guard l(m);
 		}
 		// "the lock does not need to be held for notification" (c) https://en.cppreference.com/w/cpp/thread/condition_variable
-		if (notifyOne) {
+		if (tasks.size() == 1) {
 			cvWorker.notify_one();
 		} else {
 			cvWorker.notify_all();
@@ -200,40 +327,34 @@ namespace dimgel {
 	}
 
 
+	void ThreadPool::debugOutputStats(Log& log, const char* phaseName) {
+		using Seconds = std::chrono::duration<double>;
+		auto seconds = [](std::atomic<int64_t>& d) { return Seconds(std::chrono::steady_clock::duration(d.exchange(0))).count(); };
+		size_t n = numMerges.exchange(0);
+		double merge = seconds(mergeDuration);
+		double mergeWait = seconds(mergeWaitDuration);
+		double combine = seconds(combineDuration);
+		log.debug(
+			FILE_LINE "stats: ThreadPool after %s: %lu merge() call(s) took %.3fs, waited %.3fs for merge mutex; parallel combine() took %.3fs",
+			phaseName, ulong{n}, merge, mergeWait, combine
+		);
+	}
+
+
 	void ThreadPool::waitAll_impl(State newState) {
 		std::unique_lock l(m);
 		if (state != State::ACTIVE) {
 			throw std::runtime_error(FILE_LINE "waitAll_impl(): state != ACTIVE");
 		}
 		state = newState;
-		bool mustNotify = state == State::DESTRUCTING;
-		while (true) {
-			// RACE:
-			// - All threads complete their trivial tasks and enter cvWorker.wait() before I get here.
-			// - Now (queue.empty() && numBusyThreads == 0) but all threads are sleeping.
-			// - If we're in destructor, join() will hang forever.
-			//
-			// Same RACE might happen if I call waitAll() right before destruction:
-			// - First waitAll_impl() call ensures all tasks are done, then the second waitAll_impl() is called by destructor.
-			// - Now (queue.empty() && numBusyThreads == 0) but all threads are sleeping.
-			//
-			// So in destructor, I must wake up them all BEFORE checking if (queue.empty() && numBusyThreads == 0) and returning.
-			// It's enough to do it only once after state := DESTRUCTING, not on each iteration of while() loop; thus `mustNotify` flag.
-			//
-			// But I don't need to wake up threads if state := WAITING, because no action is required from them:
-			// they may sleep until addTasks() or waitAll_imp(DESTRUCTING) awake them.
-			// Conceptually, I must awake anyone only when some action is requred from them -- be that new task to execute or termination request.
-			if (mustNotify) {
-				mustNotify = false;
-				cvWorker.notify_all();
-			}
-
-			if (queue.empty() && numBusyThreads == 0) {
-				break;
-			}
+		while (numPendingTasks != 0) {
 			cvMain.wait(l);
 		}
-		if (state != State::DESTRUCTING) {
+		if (state == State::DESTRUCTING) {
+			// All workers are idle: either sleeping, or about to check state under mutex I'm holding. Wake them up to exit.
+			// Can't do it before the loop above: woken worker would see pending tasks of busy ones and fall asleep again.
+			cvWorker.notify_all();
+		} else {
 			state = State::ACTIVE;
 		}
 	}
@@ -249,6 +370,25 @@ namespace dimgel {
 	}
 
 
+	void ThreadPool::cancelAll() {
+		stopping = true;
+		size_t n = threads.size();
+		for (size_t i = 0;  i < n;  i++) {
+			std::deque<std::unique_ptr<Task>> dropped;
+			{
+				std::lock_guard g(workers[i].lock);
+				dropped.swap(workers[i].tasks);
+				numQueuedTasks -= dropped.size();
+			}
+			// Only waitAll_impl() below waits for it to drop to 0, so no notification is needed.
+			numPendingTasks -= dropped.size();
+		}
+		waitAll_impl(State::WAITING);
+		waitAllResult = true;
+		stopping = false;
+	}
+
+
 	ThreadPool::~ThreadPool() {
 		waitAll_impl(State::DESTRUCTING);
 		for (auto& t : threads) {
@@ -1,14 +1,23 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <functional>
+#include <memory>
 #include <mutex>
-#include <queue>
+#include <span>
 #include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
+#include "Spinlock.h"
 
 
 namespace dimgel {
+	class Log;
+
 
 	// API is not thread-safe. I assume that all API methods are called from single ("main") thread.
 	class ThreadPool final {
@@ -29,8 +38,10 @@ namespace dimgel {
 			// Called first, in parallel.
 			virtual void compute() {};
 
-			// Called second, under ThreadPool's mutex, so only one merge() is executing at any moment.
-			// If main thread does not interfere beween addTasks() and waitAll() / ~ThreadPool() calls, there'll be no races.
+			// Called second, under ThreadPool's merge mutex, so only one merge() is executing at any moment.
+			// If main thread does not touch what merge() touches between addTasks() and waitAll() / cancelAll() / ~ThreadPool() calls,
+			// there'll be no races. Everything tasks reference must outlive them: if main thread throws between addTasks() and waitAll(),
+			// it must call cancelAll() before unwinding destroys anything queued tasks reference.
 			virtual void merge() {};
 		};
 
@@ -47,22 +58,192 @@ namespace dimgel {
 		};
 
 
+		// For groupTasks() parameter numTasksPerGroup.
+		static constexpr int Guided = 0;
+
+
 	private:
+		// Guided self-scheduling: tasks are not split into groups upfront. Instead, each of up to getNumThreads() GuidedGroup-s sharing
+		// the same GuidedRange repeatedly claims next chunk of (remaining / (2 * numThreads)) tasks, but at least 1.
+		// So first chunks are large (few atomic ops), and last ones are single tasks.
+		//
+		// Costly tasks are often adjacent (e.g. large libraries in the same directory) and end up in the same chunk, so claimed chunk
+		// is not private either: its not yet started part is kept in `slots` and, when shared range is exhausted, idle groups steal
+		// upper half of the largest one. So whoever got unlucky with slow tasks is helped by others instead of holding up the whole phase.
+		struct GuidedRange {
+			size_t size;
+			size_t numThreads;
+			std::atomic<size_t> next = 0;
+			// Per group: not yet started part of its claimed chunk, as (begin << 32 | end).
+			std::unique_ptr<std::atomic<uint64_t>[]> slots;
+			size_t numSlots;
+
+		private:
+			// Each returns false if nothing left.
+			bool takeOne(size_t iSlot, size_t& i) noexcept;
+			bool claim(size_t iSlot) noexcept;
+			bool steal(size_t iSlot) noexcept;
+
+		public:
+			GuidedRange(size_t size, size_t numThreads, size_t numSlots);
+
+			// Returns next index for group `iSlot` to compute, or false if nothing left.
+			bool take(size_t iSlot, size_t& i) noexcept {
+				while (!takeOne(iSlot, i)) {
+					if (!claim(iSlot) && !steal(iSlot)) {
+						return false;
+					}
+				}
+				return true;
+			}
+		};
+
+		struct GuidedTasks : GuidedRange {
+			std::vector<std::unique_ptr<Task>> tasks;
+			GuidedTasks(std::vector<std::unique_ptr<Task>> tasks, size_t numThreads, size_t numSlots)
+				: GuidedRange(tasks.size(), numThreads, numSlots), tasks(std::move(tasks)) {}
+		};
+
+		// Like TaskGroup, first compute() of all tasks it took, then merge(); each task is deleted right after its merge().
+		class GuidedGroup final : public Task {
+			const ThreadPool& owner;
+			std::shared_ptr<GuidedTasks> range;
+			size_t iSlot;
+			// Computed tasks, as [begin, end) runs.
+			std::vector<std::pair<size_t, size_t>> runs;
+		public:
+			GuidedGroup(const ThreadPool& owner, std::shared_ptr<GuidedTasks> range, size_t iSlot) : owner(owner), range(std::move(range)), iSlot(iSlot) {}
+			void compute() override;
+			void merge() override;
+		};
+
+		// For parallelFor(): no combine() step, each worker's State is merged separately.
+		struct NoCombine {};
+
+		// See parallelFor() and parallelReduce(). One per worker, sharing single Shared.
+		template<class State, class T, class Compute, class Combine, class Merge> class ParallelForGroup final : public Task {
+		public:
+			struct Shared : GuidedRange {
+				std::span<T> items;
+				Compute compute;
+				Combine combine;
+				Merge merge;
+				// Per group. Kept here, not in group: group which handed its State over to another one may be deleted before it's combined.
+				std::unique_ptr<State[]> states;
+
+				// Reduction: State handed over by finished group and not yet picked up by another one,
+				// and number of States not yet combined into others (including that one).
+				Spinlock reduceLock;
+				size_t iPendingState = SIZE_MAX;
+				size_t numStatesLeft;
+
+				Shared(std::span<T> items, Compute compute, Combine combine, Merge merge, size_t numThreads, size_t numSlots)
+					: GuidedRange(items.size(), numThreads, numSlots), items(items), compute(std::move(compute)), combine(std::move(combine)),
+					  merge(std::move(merge)), states(std::make_unique<State[]>(numSlots)), numStatesLeft(numSlots) {}
+			};
+
+		private:
+			ThreadPool& owner;
+			std::shared_ptr<Shared> shared;
+			size_t iSlot;
+			// With Combine: true if all other States were combined into this group's one, so it's this group's job to merge it.
+			bool isFinal = false;
+
+			// Repeatedly picks up State handed over by some other finished group and combines it into own one, outside of any lock;
+			// so pairs of States are combined in parallel. If there's nothing to pick up, hands own State over and quits,
+			// unless it's the last State left.
+			void reduce() {
+				State& state = shared->states[iSlot];
+				while (!owner.stopping) {
+					size_t iOther;
+					{
+						std::lock_guard g(shared->reduceLock);
+						if (shared->iPendingState == SIZE_MAX) {
+							if (shared->numStatesLeft == 1) {
+								isFinal = true;
+							} else {
+								shared->iPendingState = iSlot;
+							}
+							return;
+						}
+						iOther = shared->iPendingState;
+						shared->iPendingState = SIZE_MAX;
+						shared->numStatesLeft--;
+					}
+					auto start = std::chrono::steady_clock::now();
+					std::as_const(shared->combine)(state, shared->states[iOther]);
+					shared->states[iOther] = State{};
+					owner.combineDuration += (std::chrono::steady_clock::now() - start).count();
+				}
+			}
+
+		public:
+			ParallelForGroup(ThreadPool& owner, std::shared_ptr<Shared> shared, size_t iSlot) : owner(owner), shared(std::move(shared)), iSlot(iSlot) {}
+
+			void compute() override {
+				State& state = shared->states[iSlot];
+				size_t i;
+				while (!owner.stopping && shared->take(iSlot, i)) {
+					std::as_const(shared->compute)(state, shared->items[i]);
+				}
+				if constexpr (!std::is_same_v<Combine, NoCombine>) {
+					reduce();
+				}
+			}
+
+			void merge() override {
+				if (std::is_same_v<Combine, NoCombine> || isFinal) {
+					if (!owner.stopping) {
+						std::as_const(shared->merge)(shared->states[iSlot]);
+					}
+				}
+			}
+		};
+
+		template<class State, class T, class Compute, class Combine, class Merge> void parallelFor_impl(std::span<T> items, Compute compute, Combine combine, Merge merge) {
+			if (items.empty()) {
+				return;
+			}
+			using Group = ParallelForGroup<State, T, Compute, Combine, Merge>;
+			size_t numGroups = std::min(items.size(), threads.size());
+			auto shared = std::make_shared<typename Group::Shared>(items, std::move(compute), std::move(combine), std::move(merge), threads.size(), numGroups);
+			std::vector<std::unique_ptr<Task>> groups;
+			groups.reserve(numGroups);
+			for (size_t i = 0;  i < numGroups;  i++) {
+				groups.push_back(std::make_unique<Group>(*this, shared, i));
+			}
+			addTasks(std::move(groups));
+		}
+
+
 		enum class State {
 			ACTIVE,
 			WAITING,
 			DESTRUCTING
 		};
 
+		// Each worker takes tasks from front of its own deque; when it's empty, steals from front of others' deques.
+		// Front, because addTasks() keeps submission order and callers submit most expensive tasks first:
+		// so idle worker takes over the largest task left instead of the smallest one.
+		struct alignas(64) Worker {
+			Spinlock lock;
+			std::deque<std::unique_ptr<Task>> tasks;
+		};
+
 		std::function<void(const char* exceptionMessage)> onTaskException;
-		State state = State::ACTIVE;
-		int numBusyThreads;
 		std::vector<std::thread> threads;
-		// TODO Specify std:queue's underlying collection?
-		std::queue<std::unique_ptr<Task>> queue;
+		std::unique_ptr<Worker[]> workers;
+		// Worker to receive next task from addTasks(); rotates so small batches don't all land on worker 0.
+		size_t nextWorker = 0;
+		// Number of tasks in all deques. Incremented by addTasks() BEFORE pushing, so it may be greater than actual number for a moment:
+		// then idle worker just retries. But never less: otherwise worker could go to sleep leaving task in some deque.
+		std::atomic<size_t> numQueuedTasks = 0;
+		// Queued plus executing tasks; waitAll() returns when it drops to 0.
+		std::atomic<size_t> numPendingTasks = 0;
 		std::atomic_bool waitAllResult = true;
 		std::atomic_bool stopping = false;
 
+		// Taken only to sleep and wake up, not to add or get tasks.
 		// Waking up threads: https://stackoverflow.com/a/32234772
 		// For worker threads to wake up when new tasks are available or destructor is called.
 		std::condition_variable cvWorker;
@@ -70,9 +251,22 @@ namespace dimgel {
 		std::condition_variable cvMain;
 		// Both cv-s share same mutex: https://stackoverflow.com/q/4062126
 		std::mutex m;
+		// Changed only by main thread under m, so main thread's addTasks() reads it without taking m. Workers read it under m.
+		std::atomic<State> state = State::ACTIVE;
+
+		// Serializes Task::merge() calls.
+		std::mutex mergeMutex;
 
-		static void threadFunction(ThreadPool* self);
-		void threadMethod();
+		// Instrumentation for debugOutputStats(), durations are in steady_clock ticks.
+		std::atomic<size_t> numMerges = 0;
+		std::atomic<int64_t> mergeDuration = 0;
+		std::atomic<int64_t> mergeWaitDuration = 0;
+		std::atomic<int64_t> combineDuration = 0;
+
+		static void threadFunction(ThreadPool* self, size_t iWorker);
+		void threadMethod(size_t iWorker);
+		// Pops from own deque, or steals. Returns nullptr if all deques are empty.
+		std::unique_ptr<Task> takeTask(size_t iWorker);
 		int getNumThreads() const noexcept { return threads.size(); }
 		void processTaskException(const char* exceptionMessage, bool isAbort);
 		void waitAll_impl(State newState);
@@ -91,24 +285,59 @@ namespace dimgel {
 		// ATTENTION: If you use groupTasks() which you should, then after some task throws exception all remaining tasks in group don't get executed.
 		ThreadPool(int numWorkerThreads, std::function<void(const char* exceptionMessage)> onTaskException);
 
-		// This is to avoid abusing mutex too much if tasks are small and many. Returns TaskGroup-s.
+		// This is to avoid abusing ThreadPool too much if tasks are small and many. Returns TaskGroup-s or GuidedGroup-s.
 		// Parameter `tasks` must be passed with std::move(), because std::unique_ptr() cannot be copied.
 		//
+		// If numTasksPerGroup == Guided (default), tasks are handed out in shrinking chunks, see GuidedRange.
+		// Use it unless tasks are known to cost the same: then fixed groups below have less overhead.
+		//
 		// If numTasksPerGroup > 0, it's upper bound. Some groups may contain fewer tasks, to evenly split the remainder.
 		// E.g. numTasks = 101, numTasksPerGroup = 30 ---> numGroups = 4, numTasksPerGroup = 25, remainder = 1 ---> group sizes are 26 (1 group) and 25 (3 groups).
 		//
 		// If numTasksPerGroup < 0, then tasks are split into getNumThreads() * (-numTasksPerGroup) groups of equal size.
 		// Some groups may contain more tasks computed size -- to evenly split the remainder.
-		std::vector<std::unique_ptr<Task>> groupTasks(std::vector<std::unique_ptr<Task>> tasks, int numTasksPerGroup = -1) const;
+		std::vector<std::unique_ptr<Task>> groupTasks(std::vector<std::unique_ptr<Task>> tasks, int numTasksPerGroup = Guided) const;
 
 		// Parameter `tasks` must be passed with std::move(), because std::unique_ptr() cannot be copied.
 		void addTasks(std::vector<std::unique_ptr<Task>> tasks);
 
+		// For phases over existing collection: calls compute(state, item) for each item in parallel, then merge(state) once per State instance,
+		// serialized like Task::merge(). Items are handed out like by groupTasks(Guided), but there's no Task + unique_ptr per item,
+		// and no virtual call per item: only one group Task per worker is allocated. State is default-constructed once per worker,
+		// e.g. vector to collect results into; use overload without merge() if nothing to merge.
+		//
+		// Like addTasks(), it returns immediately, and `items` must stay alive until waitAll(). compute() is called concurrently, so must be const.
+		// If compute() throws, merge() of its State is not called, and other workers stop as with TaskGroup.
+		template<class State, class T, class Compute, class Merge> void parallelFor(std::span<T> items, Compute compute, Merge merge) {
+			parallelFor_impl<State>(items, std::move(compute), NoCombine{}, std::move(merge));
+		}
+
+		// Same as parallelFor(), but States of all workers are first reduced to single one by combine(State& into, State& from),
+		// called in parallel for different pairs as workers finish; then merge() is called once for the resulting State.
+		// Use it when merge() does more than cheap appending, so only one merge() holds merge mutex, and less work is done under it.
+		// If compute() or combine() throws, merge() is not called.
+		template<class State, class T, class Compute, class Combine, class Merge> void parallelReduce(std::span<T> items, Compute compute, Combine combine, Merge merge) {
+			parallelFor_impl<State>(items, std::move(compute), std::move(combine), std::move(merge));
+		}
+
+		template<class T, class Compute> void parallelFor(std::span<T> items, Compute compute) {
+			struct NoState {};
+			parallelFor<NoState>(items, [compute = std::move(compute)](NoState&, T& item) { compute(item); }, [](NoState&) {});
+		}
+
+		// Logs time spent in merge() calls, waiting for merge mutex, and in parallelReduce()'s combine() calls since previous call,
+		// then resets counters. Call after waitAll() of phase named `phaseName`.
+		void debugOutputStats(Log& log, const char* phaseName);
+
 		// Waits until ALL tasks (active and queued) are completed.
 		// Throws Abort if some task threw exceptions since previous waitAll();
 		// at that moment those exceptions are already processed by onTaskException callback.
 		void waitAll();
 
+		// Drops queued tasks without calling them, makes executing groups stop as if some task threw, and waits until executing tasks complete.
+		// Does not throw Abort: exceptions thrown by tasks since previous waitAll() are forgotten (but were passed to onTaskException callback).
+		void cancelAll();
+
 		// Waits until ALL tasks (active and queued) are completed.
 		~ThreadPool();
 	};
@@ -52,6 +52,280 @@ namespace dimgel::util {
 		}
 	}
 
+	//----------------------------------------------------------------------------------------------------------------------------------------
+
+
+	namespace {
+		inline bool isSpace(char c) noexcept {
+			return c == ' ' || (c >= '\t' && c <= '\r');
+		}
+
+		// Matches regex '.*' (to end of line).
+		inline bool isDotStar(std::string_view s) noexcept {
+			return s.find_first_of("\r\n") == std::string_view::npos;
+		}
+
+		// Sequential matcher: each method either consumes what it matched and returns true, or returns false.
+		// After false, position is unspecified: it's assumed that whole match fails.
+		class Scanner {
+			std::string_view s;
+			size_t pos = 0;
+
+		public:
+			explicit Scanner(std::string_view s) noexcept : s(s) {}
+
+			bool atEnd() const noexcept { return pos == s.length(); }
+			std::string_view rest() const noexcept { return s.substr(pos); }
+
+			bool skip(char c) noexcept {
+				if (pos < s.length() && s[pos] == c) {
+					pos++;
+					return true;
+				}
+				return false;
+			}
+
+			bool skip(std::string_view literal) noexcept {
+				if (s.substr(pos).starts_with(literal)) {
+					pos += literal.length();
+					return true;
+				}
+				return false;
+			}
+
+			// \s*, returns number of chars skipped.
+			size_t skipSpaces() noexcept {
+				size_t p0 = pos;
+				while (pos < s.length() && isSpace(s[pos])) {
+					pos++;
+				}
+				return pos - p0;
+			}
+
+			// \S+ (greedy; no backtracking is needed if next token starts with \s or is end of line).
+			bool nonSpaces(std::string_view& out) noexcept {
+				size_t p0 = pos;
+				while (pos < s.length() && !isSpace(s[pos])) {
+					pos++;
+				}
+				out = s.substr(p0, pos - p0);
+				return pos > p0;
+			}
+
+			// [^c]+ (greedy; no backtracking is needed if next token is c).
+			bool notChar(char c, std::string_view& out) noexcept {
+				size_t p0 = pos;
+				while (pos < s.length() && s[pos] != c) {
+					pos++;
+				}
+				out = s.substr(p0, pos - p0);
+				return pos > p0;
+			}
+
+			// \d{1,maxDigits}
+			bool digits(size_t maxDigits, std::string_view& out) noexcept {
+				size_t p0 = pos;
+				while (pos < s.length() && pos - p0 < maxDigits && s[pos] >= '0' && s[pos] <= '9') {
+					pos++;
+				}
+				out = s.substr(p0, pos - p0);
+				return pos > p0;
+			}
+		};
+	}
+
+
+	bool isSharedLibName(std::string_view fileName) {
+		if (!isDotStar(fileName)) {
+			return false;
+		}
+		for (auto i = fileName.find(".so", 1);  i != std::string_view::npos;  i = fileName.find(".so", i + 1)) {
+			if (i + 3 == fileName.length() || fileName[i + 3] == '.') {
+				return true;
+			}
+		}
+		return false;
+	}
+
+
+	bool parseLdconfigFirstLine(std::string_view line, int& numLibs) {
+		Scanner sc(line);
+		std::string_view d;
+		// \d{1,9} followed by ' ': 10th digit would fail skip(' ').
+		if (!(sc.digits(9, d) && sc.skip(' ') && isDotStar(sc.rest()))) {
+			return false;
+		}
+		numLibs = 0;
+		for (char c : d) {
+			numLibs = numLibs * 10 + (c - '0');
+		}
+		return true;
+	}
+
+
+	bool parseLdconfigLine(std::string_view line, std::string_view& name, std::string_view& path1) {
+		Scanner sc(line);
+		std::string_view type;
+		return sc.skip('\t') && sc.nonSpaces(name) && sc.skip(" (") && sc.notChar(')', type) && sc.skip(") => /") && sc.nonSpaces(path1) && sc.atEnd();
+	}
+
+
+	bool isLdconfigLastLine(std::string_view line) {
+		return !line.empty() && !isSpace(line[0]) && line.find(" ldconfig ", 1) != std::string_view::npos && isDotStar(line);
+	}
+
+
+	bool parseWordSpaceWord(std::string_view line, std::string_view& word1, std::string_view& word2) {
+		Scanner sc(line);
+		return sc.nonSpaces(word1) && sc.skip(' ') && sc.nonSpaces(word2) && sc.atEnd();
+	}
+
+
+	bool parseTwoWords(std::string_view line, std::string_view& word1, std::string_view& word2) {
+		Scanner sc(line);
+		sc.skipSpaces();
+		if (!(sc.nonSpaces(word1) && sc.skipSpaces() > 0 && sc.nonSpaces(word2))) {
+			return false;
+		}
+		sc.skipSpaces();
+		return sc.atEnd();
+	}
+
+
+	bool parseKeyValue(std::string_view line, std::string_view& key, std::string_view& value) {
+		Scanner sc(line);
+		std::string_view word;
+		if (!sc.nonSpaces(word)) {
+			return false;
+		}
+
+		// Try key = whole first word (longest), then backtrack to each '=' inside first word, from last to first.
+		auto tryRest = [&](std::string_view k, std::string_view rest) {
+			Scanner sc2(rest);
+			sc2.skipSpaces();
+			if (!sc2.skip('=')) {
+				return false;
+			}
+			sc2.skipSpaces();
+			if (sc2.atEnd() || !isDotStar(sc2.rest())) {
+				return false;
+			}
+			key = k;
+			value = sc2.rest();
+			return true;
+		};
+		if (tryRest(word, line.substr(word.length()))) {
+			return true;
+		}
+		for (auto i = word.rfind('=');  i != std::string_view::npos && i > 0;  i = word.rfind('=', i - 1)) {
+			if (tryRest(word.substr(0, i), line.substr(i))) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+
+	bool parseMtree(std::string_view text, std::function<void(const std::string& path1, std::string_view type, const std::string& link)> f) {
+		// bsdtar escapes everything except printable non-space ASCII (and also '#', '=', '\\') as \ooo.
+		auto unescape = [](std::string_view s, std::string& out) {
+			out.clear();
+			for (size_t i = 0;  i < s.length();  i++) {
+				if (s[i] != '\\') {
+					out += s[i];
+					continue;
+				}
+				if (s.length() - i < 4) {
+					return false;
+				}
+				int c = 0;
+				for (size_t j = i + 1;  j <= i + 3;  j++) {
+					if (s[j] < '0' || s[j] > '7') {
+						return false;
+					}
+					c = c * 8 + (s[j] - '0');
+				}
+				if (c > 255) {
+					return false;
+				}
+				out += (char)c;
+				i += 3;
+			}
+			return true;
+		};
+
+		std::string_view defaultType;
+		std::string line, path1, link;
+		size_t pos = 0;
+		while (pos < text.length()) {
+			// Join continued lines: trailing '\\' can't be part of \ooo escape.
+			line.clear();
+			while (pos < text.length()) {
+				auto eol = text.find('\n', pos);
+				auto part = text.substr(pos, eol == std::string_view::npos ? std::string_view::npos : eol - pos);
+				pos = eol == std::string_view::npos ? text.length() : eol + 1;
+				if (!part.ends_with('\\')) {
+					line.append(part);
+					break;
+				}
+				line.append(part.substr(0, part.length() - 1)).append(" ");
+			}
+
+			Scanner sc(line);
+			sc.skipSpaces();
+			if (sc.atEnd() || sc.rest().starts_with('#')) {
+				continue;
+			}
+			std::string_view path;
+			sc.nonSpaces(path);
+			bool isSet = path == "/set";
+			bool isUnset = path == "/unset";
+			if (!isSet && !isUnset && !path.starts_with("./")) {
+				return false;
+			}
+
+			std::string_view type = defaultType, rawLink;
+			bool hasType = false;
+			std::string_view kw;
+			while (sc.skipSpaces(), sc.nonSpaces(kw)) {
+				auto iEq = kw.find('=');
+				auto key = kw.substr(0, iEq);
+				auto value = iEq == std::string_view::npos ? std::string_view() : kw.substr(iEq + 1);
+				if (isUnset) {
+					if (key == "type" || key == "all") {
+						defaultType = {};
+					}
+				} else if (key == "type") {
+					type = value;
+					hasType = true;
+				} else if (key == "link" && !isSet) {
+					rawLink = value;
+				}
+			}
+			if (isSet) {
+				if (hasType) {
+					// Keep static string: `type` points into `line` which will be overwritten.
+					static constexpr std::string_view types[] = {"file", "dir", "link", "block", "char", "fifo", "socket"};
+					auto it = std::find(std::begin(types), std::end(types), type);
+					if (it == std::end(types)) {
+						return false;
+					}
+					defaultType = *it;
+				}
+			} else if (!isUnset) {
+				if (!unescape(path.substr(2), path1) || !unescape(type == "link" ? rawLink : std::string_view(), link)) {
+					return false;
+				}
+				f(path1, type, link);
+			}
+		}
+		return true;
+	}
+
+
+	//----------------------------------------------------------------------------------------------------------------------------------------
+
+
 	std::string regex_escape(const std::string& s) {
 		// Adopted from: https://stackoverflow.com/a/39237913/4247442
 		static const char metachars[] = R"(\.^$-+()[]{}|?*)";
@@ -179,14 +453,14 @@ namespace dimgel::util {
 
 	statx_Result statx(const char* path) {
 		struct statx st;
-		constexpr decltype(st.stx_mask) mask = STATX_TYPE | STATX_MODE | STATX_INO;
+		constexpr decltype(st.stx_mask) mask = STATX_TYPE | STATX_MODE | STATX_INO | STATX_MTIME;
 		if (::statx(AT_FDCWD, path, AT_NO_AUTOMOUNT | AT_SYMLINK_NOFOLLOW, mask, &st) == -1) {
 			throw Error(FILE_LINE "::statx(`%s`) failed: %s", path, strerror(errno));
 		}
 		if ((st.stx_mask & mask) != mask) {
 			throw Error(FILE_LINE "::statx(`%s`) returned incomplete data; unsupported filesystem?", path);
 		}
-		return {.mode = st.stx_mode, .inode = st.stx_ino};
+		return {.mode = st.stx_mode, .inode = st.stx_ino, .mtimeNs = st.stx_mtime.tv_sec * 1'000'000'000LL + st.stx_mtime.tv_nsec};
 	}
 
 
@@ -254,6 +528,45 @@ namespace dimgel::util {
 	}
 
 
+	StringRef::Mutable readFile(const char* path, std::vector<char>& buf) {
+		Closeable fd {open(path, O_RDONLY)};
+		if (fd < 0) {
+			throw Error(FILE_LINE "readFile(`%s`): open() failed: %s", path, strerror(errno));
+		}
+		struct stat st;
+		if (fstat(fd, &st) < 0) {
+			throw Error(FILE_LINE "readFile(`%s`): fstat() failed: %s", path, strerror(errno));
+		}
+		if (!S_ISREG(st.st_mode)) {
+			throw Error(FILE_LINE "readFile(`%s`): not a regular file", path);
+		}
+
+		size_t size = (size_t)st.st_size;
+		if (buf.size() < size + 1) {
+			buf.resize(size + 1);
+		}
+		char* s = buf.data();
+
+		size_t done = 0;
+		while (done < size) {
+			auto n = read(fd, s + done, size - done);
+			if (n < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				throw Error(FILE_LINE "readFile(`%s`): read() failed: %s", path, strerror(errno));
+			}
+			if (n == 0) {
+				throw Error(FILE_LINE "readFile(`%s`): read wrong number of bytes", path);
+			}
+			done += n;
+		}
+		s[size] = '\0';
+
+		return {StringRef::createUnsafe(s, size)};
+	}
+
+
 	int forkExec(const char* argv[], bool requireStatus0) {
 		int pid = fork();
 		if (pid == -1) {
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <dirent.h>
+#include <functional>
 #include <optional>
 #include <regex>
 #include <sys/stat.h>
@@ -32,13 +33,49 @@ namespace dimgel::util {
 
 	std::string regex_escape(const std::string& s);
 
-	inline auto regex_match(std::string_view s, std::regex r) { return std::regex_match(s.begin(), s.end(), r); }
-	inline auto regex_match(StringRef        s, std::regex r) { return regex_match(s.sv(), r); }
-	inline auto regex_match(alloc::String    s, std::regex r) { return regex_match(s.sv(), r); }
+	inline auto regex_match(std::string_view s, const std::regex& r) { return std::regex_match(s.begin(), s.end(), r); }
+	inline auto regex_match(StringRef        s, const std::regex& r) { return regex_match(s.sv(), r); }
+	inline auto regex_match(alloc::String    s, const std::regex& r) { return regex_match(s.sv(), r); }
 
-	inline auto regex_match(std::string_view s, std::cmatch& m, std::regex r) { return std::regex_match(s.begin(), s.end(), m, r); }
-	inline auto regex_match(StringRef        s, std::cmatch& m, std::regex r) { return regex_match(s.sv(), m, r); }
-	inline auto regex_match(alloc::String    s, std::cmatch& m, std::regex r) { return regex_match(s.sv(), m, r); }
+	inline auto regex_match(std::string_view s, std::cmatch& m, const std::regex& r) { return std::regex_match(s.begin(), s.end(), m, r); }
+	inline auto regex_match(StringRef        s, std::cmatch& m, const std::regex& r) { return regex_match(s.sv(), m, r); }
+	inline auto regex_match(alloc::String    s, std::cmatch& m, const std::regex& r) { return regex_match(s.sv(), m, r); }
+
+
+	// Hand-written matchers for fixed line formats, instead of std::regex which is slow and allocates.
+	// Each accepts exactly same lines as ECMAScript regex in its comment (where \s = [ \t\n\v\f\r], and '.' does not match '\r' and '\n').
+	// Output views point into input.
+
+	// ^.+\.so(\..*)?$
+	bool isSharedLibName(std::string_view fileName);
+
+	// ^(\d{1,9}) .*$
+	// First line of `ldconfig -p`, e.g. "1234 libs found in cache `/etc/ld.so.cache'"; it's localized, so only number is parsed.
+	bool parseLdconfigFirstLine(std::string_view line, int& numLibs);
+
+	// ^\t(\S+) \([^\)]+\) => /(\S+)$
+	// E.g. "\tlibz.so.1 (libc6,x86-64) => /usr/lib/libz.so.1": name = "libz.so.1", path1 = "usr/lib/libz.so.1".
+	bool parseLdconfigLine(std::string_view line, std::string_view& name, std::string_view& path1);
+
+	// ^\S.* ldconfig .*$
+	// Last line of `ldconfig -p`, e.g. "Cache generated by: ldconfig (GNU libc) release release version 2.36"; it's localized too.
+	bool isLdconfigLastLine(std::string_view line);
+
+	// ^(\S+) (\S+)$
+	bool parseWordSpaceWord(std::string_view line, std::string_view& word1, std::string_view& word2);
+
+	// ^\s*(\S+)\s+(\S+)\s*$
+	bool parseTwoWords(std::string_view line, std::string_view& word1, std::string_view& word2);
+
+	// ^(\S+)\s*=\s*(\S.*)$
+	// Like regex, key is longest possible: "a=b=c" gives key = "a=b", value = "c".
+	bool parseKeyValue(std::string_view line, std::string_view& key, std::string_view& value);
+
+	// Parses mtree(5) text as written by `bsdtar --format=mtree` (e.g. gunzipped `.MTREE` entry of Arch package): full paths starting with "./",
+	// `/set` and `/unset` lines, \ooo escapes, '\' line continuations. Calls f(path1, type, link) for each entry, where path1 is path without "./",
+	// type is e.g. "file", "dir" or "link" (or empty if not specified), and link is empty unless type is "link"; path1 and link are unescaped.
+	// Returns false on anything else (e.g. mtree v1 relative paths); f() may have been called by then.
+	bool parseMtree(std::string_view text, std::function<void(const std::string& path1, std::string_view type, const std::string& link)> f);
 
 
 	template<class T               > void sort(std::vector<T>& v             ) { std::sort(v.begin(), v.end()     ); }
@@ -70,6 +107,7 @@ namespace dimgel::util {
 	struct statx_Result {
 		decltype(stat::st_mode) mode;
 		decltype(stat::st_ino) inode;
+		int64_t mtimeNs;
 	};
 
 	statx_Result statx(const char* path);
@@ -82,6 +120,10 @@ namespace dimgel::util {
 
 	BufAndRef readFile(const char* path);
 
+	// Same as above, but reads into caller's buffer which is reused (grown if needed) between calls, e.g. thread_local one;
+	// and throws if `path` is not a regular file. Returned reference points into `buf`.
+	StringRef::Mutable readFile(const char* path, std::vector<char>& buf);
+
 
 	// argv[0] must contain absoulte path, it will be also used for `pathname` parameter of `execv()`.
 	// argv[]'s last element must be nullptr.
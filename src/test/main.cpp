@@ -1,17 +1,34 @@
 void test_util_normalizePath();
+void test_util_lineParsers();
+void test_util_mtree();
 void test_alloc();
 void test_StdCapture();
 void test_util_forkExecStdCapture();
+void test_BufferedWriter();
+void test_MappedCacheFile();
+void test_FrontCodedStringMap();
+void test_BloomFilter();
+void test_ThreadPool();
 
 
 // Grouped calls are ordered by dependency order.
 int main() {
 	test_util_normalizePath();
+	test_util_lineParsers();
+	test_util_mtree();
 
 	test_alloc();
 
 	test_StdCapture();
 	test_util_forkExecStdCapture();
 
+	test_BufferedWriter();
+	test_MappedCacheFile();
+
+	test_FrontCodedStringMap();
+	test_BloomFilter();
+
+	test_ThreadPool();
+
 	return 0;
 }
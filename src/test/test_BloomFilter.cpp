@@ -0,0 +1,36 @@
+#undef NDEBUG
+
+#include <assert.h>
+#include <string>
+#include "../main/util/BloomFilter.h"
+
+using namespace dimgel;
+
+
+void test_BloomFilter() {
+	assert(!BloomFilter().mayContain(""));
+	assert(!BloomFilter().mayContain("libfoo.so.1"));
+
+	BloomFilter f(1000);
+	for (int i = 0;  i < 1000;  i++) {
+		f.add("libfoo" + std::to_string(i) + ".so.1");
+	}
+	for (int i = 0;  i < 1000;  i++) {
+		assert(f.mayContain("libfoo" + std::to_string(i) + ".so.1"));
+	}
+
+	// No false negatives above; false positives must be rare: expected ~0.1%, allow 1%.
+	int numFalsePositives = 0;
+	for (int i = 0;  i < 10000;  i++) {
+		if (f.mayContain("libbar" + std::to_string(i) + ".so.1")) {
+			numFalsePositives++;
+		}
+	}
+	assert(numFalsePositives < 100);
+
+	// Single block.
+	BloomFilter f1(1);
+	f1.add("");
+	assert(f1.mayContain(""));
+	assert(!f1.mayContain("x"));
+}
@@ -0,0 +1,41 @@
+#undef NDEBUG
+
+#include <assert.h>
+#include <stdio.h>
+#include <string>
+#include <unistd.h>
+#include "../main/util/BufferedWriter.h"
+
+using namespace dimgel;
+
+
+static std::string readAll(FILE* f) {
+	std::string s;
+	char buf[256];
+	rewind(f);
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+		s.append(buf, n);
+	}
+	return s;
+}
+
+
+void test_BufferedWriter() {
+	FILE* f = tmpfile();
+	assert(f != nullptr);
+	{
+		// Capacity is less than data size: writes must be split across flushes.
+		BufferedWriter w(fileno(f), 4);
+		w.write("Hello");
+		w.put(' ');
+		w.write("world!", 6);
+		assert(readAll(f) == "Hello wo");
+		w.flush();
+		assert(readAll(f) == "Hello world!");
+		w.put('\n');
+	}
+	// Destructor flushes.
+	assert(readAll(f) == "Hello world!\n");
+	fclose(f);
+}
@@ -0,0 +1,69 @@
+#undef NDEBUG
+
+#include <assert.h>
+#include <map>
+#include <string>
+#include "../main/util/FrontCodedStringMap.h"
+
+using namespace dimgel;
+
+
+void test_FrontCodedStringMap() {
+	// More than one block (blockSize = 16), with shared prefixes of different lengths, and key being prefix of another key.
+	std::map<std::string, int> expected;
+	for (int i = 0;  i < 50;  i++) {
+		expected["usr/lib/libfoo.so." + std::to_string(i)] = i;
+		expected["usr/bin/x" + std::to_string(i * 7)] = 100 + i;
+	}
+	expected["usr/lib/libfoo.so"] = 1000;
+	expected["usr/lib/libfoo.so.1\xFF"] = 1001;
+
+	FrontCodedStringMap<int>::Builder b;
+	for (auto& [k, v] : expected) {
+		b.add(k, v);
+	}
+	auto m = b.build();
+	assert(m.size() == expected.size());
+
+	for (auto& [k, v] : expected) {
+		auto pv = m.find(k);
+		assert(pv != nullptr && *pv == v);
+	}
+	for (auto k : {"", "a", "usr", "usr/bin/x", "usr/bin/x8", "usr/lib/libfoo.so.", "usr/lib/libfoo.so.1\x01", "usr/lib/libfoo.so.1\xFE", "zzz"}) {
+		assert(m.find(k) == nullptr);
+	}
+
+	// concat() of parts whose sizes are not multiples of blockSize, with empty part in the middle.
+	{
+		std::vector<FrontCodedStringMap<int>> parts(4);
+		std::vector<FrontCodedStringMap<int>::Builder> bs(4);
+		size_t i = 0;
+		for (auto& [k, v] : expected) {
+			bs[i < 21 ? 0 : i < 60 ? 1 : 3].add(k, v);
+			i++;
+		}
+		for (size_t j = 0;  j < 4;  j++) {
+			parts[j] = bs[j].build();
+		}
+		auto mc = FrontCodedStringMap<int>::concat(std::move(parts));
+		assert(mc.size() == expected.size());
+		for (auto& [k, v] : expected) {
+			auto pv = mc.find(k);
+			assert(pv != nullptr && *pv == v);
+		}
+		for (auto k : {"", "usr/bin/x8", "usr/lib/libfoo.so.", "zzz"}) {
+			assert(mc.find(k) == nullptr);
+		}
+	}
+
+	// Builder requires strictly ascending keys.
+	FrontCodedStringMap<int>::Builder b2;
+	b2.add("b", 1);
+	bool thrown = false;
+	try {
+		b2.add("b", 2);
+	} catch (Error&) {
+		thrown = true;
+	}
+	assert(thrown);
+}
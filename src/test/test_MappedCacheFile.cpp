@@ -0,0 +1,108 @@
+#undef NDEBUG
+
+#include <assert.h>
+#include <dirent.h>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include "../main/util/MappedCacheFile.h"
+
+using namespace dimgel;
+
+
+static constexpr MappedCacheFile::HeaderPrefix Prefix {{'T', 'E', 'S', 'T', '\0', '\0', '\0', '\0'}, 1};
+
+
+static int countFiles(const char* dirPath) {
+	DIR* d = opendir(dirPath);
+	assert(d != nullptr);
+	int n = 0;
+	while (auto e = readdir(d)) {
+		n += e->d_name[0] != '.';
+	}
+	closedir(d);
+	return n;
+}
+
+
+void test_MappedCacheFile() {
+	char dirPath[] = "/tmp/test_MappedCacheFile.XXXXXX";
+	assert(mkdtemp(dirPath) != nullptr);
+	std::string path = std::string(dirPath) + "/sub/cache";
+
+	MappedCacheFile f;
+	assert(!f.load(path.c_str(), Prefix, sizeof(Prefix)));
+
+	// Creates parent directory; record round-trip.
+	MappedCacheFile::save(path.c_str(), [](MappedCacheFile::Writer& w) {
+		w.put(Prefix);
+		w.put(MappedCacheFile::Writer::recordSize(
+			sizeof(uint32_t) + sizeof(int64_t) + MappedCacheFile::Writer::strSize("abc") + MappedCacheFile::Writer::listSize({"x", "yz"}), "abc"
+		));
+		w.put(int64_t{-5});
+		w.str("abc");
+		w.list({"x", "yz"});
+	});
+	assert(f.load(path.c_str(), Prefix, sizeof(Prefix)));
+	{
+		MappedCacheFile::Reader r(f.begin() + sizeof(Prefix), f.end());
+		r.beginRecord();
+		assert(r.get<int64_t>() == -5);
+		assert(r.str() == "abc");
+		std::vector<std::string_view> v;
+		r.list(v);
+		assert(v.size() == 2 && v[0] == "x" && v[1] == "yz");
+		assert(r.endRecord("abc") == f.end());
+	}
+
+	// Record size mismatch.
+	{
+		MappedCacheFile::Reader r(f.begin() + sizeof(Prefix), f.end());
+		r.beginRecord();
+		r.get<int64_t>();
+		bool thrown = false;
+		try {
+			r.endRecord("abc");
+		} catch (std::exception&) {
+			thrown = true;
+		}
+		assert(thrown);
+	}
+
+	// Other format version.
+	{
+		auto p2 = Prefix;
+		p2.formatVersion = 2;
+		bool thrown = false;
+		try {
+			f.load(path.c_str(), p2, sizeof(Prefix));
+		} catch (std::exception&) {
+			thrown = true;
+		}
+		assert(thrown);
+		assert(f.size() == 0);
+	}
+
+	// Failed save keeps old file and removes temporary one.
+	{
+		bool thrown = false;
+		try {
+			MappedCacheFile::save(path.c_str(), [](MappedCacheFile::Writer& w) {
+				w.put(Prefix);
+				throw std::runtime_error("test");
+			});
+		} catch (std::exception&) {
+			thrown = true;
+		}
+		assert(thrown);
+		std::string subPath = std::string(dirPath) + "/sub";
+		assert(countFiles(subPath.c_str()) == 1);
+		assert(f.load(path.c_str(), Prefix, sizeof(Prefix)));
+		f.unload();
+	}
+
+	assert(unlink(path.c_str()) == 0);
+	assert(rmdir((std::string(dirPath) + "/sub").c_str()) == 0);
+	assert(rmdir(dirPath) == 0);
+}
@@ -0,0 +1,249 @@
+#undef NDEBUG
+
+#include <assert.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "../main/util/Abort.h"
+#include "../main/util/Error.h"
+#include "../main/util/ThreadPool.h"
+
+using namespace dimgel;
+
+
+namespace {
+	class AddTask : public ThreadPool::Task {
+		int& sum;
+		int x;
+		int computed = 0;
+	public:
+		AddTask(int& sum, int x) : sum(sum), x(x) {}
+		void compute() override {
+			if (x % 97 == 0) {
+				std::this_thread::sleep_for(std::chrono::microseconds(200));
+			}
+			computed = x;
+		}
+		// Not synchronized: merge() calls must be serialized by ThreadPool.
+		void merge() override { sum += computed; }
+	};
+
+
+	// Waits until all other tasks are done: possible only if they are stolen from this task's worker.
+	class WaitTask : public ThreadPool::Task {
+		std::atomic<int>& numDone;
+		int numOthers;
+		bool& succeeded;
+	public:
+		WaitTask(std::atomic<int>& numDone, int numOthers, bool& succeeded) : numDone(numDone), numOthers(numOthers), succeeded(succeeded) {}
+		void compute() override {
+			auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+			while (numDone < numOthers && std::chrono::steady_clock::now() < deadline) {
+				std::this_thread::yield();
+			}
+			succeeded = numDone == numOthers;
+		}
+	};
+
+	class CountTask : public ThreadPool::Task {
+		std::atomic<int>& numDone;
+	public:
+		CountTask(std::atomic<int>& numDone) : numDone(numDone) {}
+		void compute() override { numDone++; }
+	};
+
+	class SleepTask : public ThreadPool::Task {
+	public:
+		void compute() override { std::this_thread::sleep_for(std::chrono::milliseconds(100)); }
+	};
+
+	class ThrowTask : public ThreadPool::Task {
+	public:
+		void compute() override { throw Error("ThrowTask"); }
+	};
+}
+
+
+void test_ThreadPool() {
+	std::atomic<int> numExceptions = 0;
+	ThreadPool tp(4, [&](const char*) { numExceptions++; });
+
+	// Ungrouped, guided groups, fixed groups.
+	for (int round = 0;  round < 3;  round++) {
+		int sum = 0;
+		std::vector<std::unique_ptr<ThreadPool::Task>> tasks;
+		for (int i = 1;  i <= 1000;  i++) {
+			tasks.push_back(std::make_unique<AddTask>(sum, i));
+		}
+		tp.addTasks(round == 0 ? std::move(tasks) : tp.groupTasks(std::move(tasks), round == 1 ? ThreadPool::Guided : 30));
+		tp.waitAll();
+		assert(sum == 500500);
+	}
+
+	// Tasks queued behind blocked one on the same worker are stolen by others.
+	{
+		std::atomic<int> numDone = 0;
+		bool succeeded = false;
+		std::vector<std::unique_ptr<ThreadPool::Task>> tasks;
+		tasks.push_back(std::make_unique<WaitTask>(numDone, 15, succeeded));
+		for (int i = 0;  i < 15;  i++) {
+			tasks.push_back(std::make_unique<CountTask>(numDone));
+		}
+		tp.addTasks(std::move(tasks));
+		tp.waitAll();
+		assert(succeeded);
+	}
+
+	// Exception is reported via callback and by waitAll(), and does not break next round.
+	{
+		int sum = 0;
+		std::vector<std::unique_ptr<ThreadPool::Task>> tasks;
+		tasks.push_back(std::make_unique<ThrowTask>());
+		tasks.push_back(std::make_unique<AddTask>(sum, 1));
+		tp.addTasks(std::move(tasks));
+		bool thrown = false;
+		try {
+			tp.waitAll();
+		} catch (Abort&) {
+			thrown = true;
+		}
+		assert(thrown);
+		assert(numExceptions == 1);
+
+		tasks.clear();
+		tasks.push_back(std::make_unique<AddTask>(sum, 2));
+		tp.addTasks(std::move(tasks));
+		tp.waitAll();
+		assert(sum == 2 || sum == 3);
+	}
+
+	// Guided groups with fewer tasks than threads.
+	{
+		int sum = 0;
+		std::vector<std::unique_ptr<ThreadPool::Task>> tasks;
+		tasks.push_back(std::make_unique<AddTask>(sum, 1));
+		tasks.push_back(std::make_unique<AddTask>(sum, 2));
+		auto groups = tp.groupTasks(std::move(tasks));
+		assert(groups.size() == 2);
+		tp.addTasks(std::move(groups));
+		tp.waitAll();
+		assert(sum == 3);
+	}
+
+	// parallelFor(): per-worker state merged once per worker; stateless overload.
+	{
+		std::vector<int> items(10000);
+		for (int i = 0;  i < (int)items.size();  i++) {
+			items[i] = i + 1;
+		}
+		long sum = 0;
+		int numMerges = 0;
+		tp.parallelFor<long>(std::span(items), [](long& s, int& x) { s += x; }, [&](long& s) { sum += s;  numMerges++; });
+		tp.waitAll();
+		assert(sum == 50005000);
+		assert(numMerges >= 1 && numMerges <= 4);
+
+		tp.parallelFor(std::span(items), [](int& x) { x = -x; });
+		tp.waitAll();
+		for (int i = 0;  i < (int)items.size();  i++) {
+			assert(items[i] == -(i + 1));
+		}
+
+		std::vector<int> empty;
+		tp.parallelFor(std::span(empty), [](int&) { assert(false); });
+		tp.waitAll();
+	}
+
+	// parallelFor(): exception in compute() is reported like for tasks.
+	{
+		std::vector<int> items(100);
+		tp.parallelFor(std::span(items), [](int&) { throw Error("parallelFor"); });
+		bool thrown = false;
+		try {
+			tp.waitAll();
+		} catch (Abort&) {
+			thrown = true;
+		}
+		assert(thrown);
+	}
+
+	// parallelReduce(): all workers' states are combined into one, merged exactly once; exception in combine() skips merge.
+	{
+		std::vector<int> items(10000);
+		for (int i = 0;  i < (int)items.size();  i++) {
+			items[i] = i + 1;
+		}
+		std::vector<long> merged;
+		tp.parallelReduce<std::vector<long>>(
+			std::span(items),
+			[](std::vector<long>& v, int& x) { v.push_back(x); },
+			[](std::vector<long>& into, std::vector<long>& from) { into.insert(into.end(), from.begin(), from.end()); },
+			[&](std::vector<long>& v) { assert(merged.empty());  merged = std::move(v); }
+		);
+		tp.waitAll();
+		assert(merged.size() == items.size());
+		long sum = 0;
+		for (long x : merged) {
+			sum += x;
+		}
+		assert(sum == 50005000);
+
+		std::vector<int> one {42};
+		int result = 0;
+		tp.parallelReduce<int>(std::span(one), [](int& s, int& x) { s += x; }, [](int&, int&) { assert(false); }, [&](int& s) { result = s; });
+		tp.waitAll();
+		assert(result == 42);
+
+		bool isMerged = false;
+		tp.parallelReduce<int>(
+			std::span(items), [](int&, int&) {}, [](int&, int&) { throw Error("parallelReduce"); }, [&](int&) { isMerged = true; }
+		);
+		bool thrown = false;
+		try {
+			tp.waitAll();
+		} catch (Abort&) {
+			thrown = true;
+		}
+		assert(thrown && !isMerged);
+	}
+
+	// cancelAll() drops queued tasks, does not throw after task exception, and does not break next round.
+	{
+		std::atomic<int> numDone = 0;
+		std::vector<std::unique_ptr<ThreadPool::Task>> tasks;
+		tasks.push_back(std::make_unique<ThrowTask>());
+		for (int i = 0;  i < 4;  i++) {
+			// Blocks workers for a while, so tasks queued behind are still there when cancelAll() is called.
+			tasks.push_back(std::make_unique<SleepTask>());
+		}
+		for (int i = 0;  i < 100;  i++) {
+			tasks.push_back(std::make_unique<CountTask>(numDone));
+		}
+		tp.addTasks(std::move(tasks));
+		tp.cancelAll();
+		assert(numDone < 100);
+
+		int sum = 0;
+		tasks.clear();
+		tasks.push_back(std::make_unique<AddTask>(sum, 2));
+		tp.addTasks(std::move(tasks));
+		tp.waitAll();
+		assert(sum == 2);
+	}
+
+	// Destructor waits for tasks left.
+	{
+		int sum = 0;
+		{
+			ThreadPool tp2(3, [](const char*) {});
+			std::vector<std::unique_ptr<ThreadPool::Task>> tasks;
+			for (int i = 1;  i <= 100;  i++) {
+				tasks.push_back(std::make_unique<AddTask>(sum, i));
+			}
+			tp2.addTasks(std::move(tasks));
+		}
+		assert(sum == 5050);
+	}
+}
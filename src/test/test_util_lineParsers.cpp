@@ -0,0 +1,173 @@
+#undef NDEBUG
+
+#include <regex>
+#include <string>
+#include "../main/util/Error.h"
+#include "../main/util/util.h"
+
+using namespace dimgel;
+
+
+// Each hand-written matcher must accept exactly same lines as regex it replaced, and capture same groups.
+// So corpus lines are checked against both.
+
+
+static void check(int lineNo, bool ok, const std::string& line, const char* regex, std::initializer_list<std::string_view> groups) {
+	std::smatch m;
+	bool rOk = std::regex_match(line, m, std::regex(regex));
+	if (ok != rOk) {
+		throw Error("Assertion failed @ line %d: `%s`: matcher returned %d, regex returned %d", lineNo, line.c_str(), (int)ok, (int)rOk);
+	}
+	if (!ok) {
+		return;
+	}
+	size_t i = 1;
+	for (auto g : groups) {
+		if (g != std::string_view(m[i].first, m[i].second)) {
+			throw Error("Assertion failed @ line %d: `%s`: group %lu is `%s`, regex says `%s`", lineNo, line.c_str(), ulong{i}, std::string(g).c_str(), m[i].str().c_str());
+		}
+		i++;
+	}
+}
+
+
+static void ldconfigFirstLine(int lineNo, const std::string& line) {
+	int n = -1;
+	bool ok = util::parseLdconfigFirstLine(line, n);
+	auto s = std::to_string(n);
+	check(lineNo, ok, line, "^(\\d{1,9}) .*$", {s});
+}
+
+static void ldconfigLine(int lineNo, const std::string& line) {
+	std::string_view name, path1;
+	bool ok = util::parseLdconfigLine(line, name, path1);
+	check(lineNo, ok, line, "^\t(\\S+) \\([^\\)]+\\) => /(\\S+)$", {name, path1});
+}
+
+static void ldconfigLastLine(int lineNo, const std::string& line) {
+	check(lineNo, util::isLdconfigLastLine(line), line, "^\\S.* ldconfig .*$", {});
+}
+
+static void wordSpaceWord(int lineNo, const std::string& line) {
+	std::string_view w1, w2;
+	bool ok = util::parseWordSpaceWord(line, w1, w2);
+	check(lineNo, ok, line, "^(\\S+) (\\S+)$", {w1, w2});
+}
+
+static void twoWords(int lineNo, const std::string& line) {
+	std::string_view w1, w2;
+	bool ok = util::parseTwoWords(line, w1, w2);
+	check(lineNo, ok, line, "^\\s*(\\S+)\\s+(\\S+)\\s*$", {w1, w2});
+}
+
+static void keyValue(int lineNo, const std::string& line) {
+	std::string_view k, v;
+	bool ok = util::parseKeyValue(line, k, v);
+	check(lineNo, ok, line, "^(\\S+)\\s*=\\s*(\\S.*)$", {k, v});
+}
+
+static void sharedLibName(int lineNo, const std::string& line) {
+	check(lineNo, util::isSharedLibName(line), line, "^.+\\.so(\\..*)?$", {});
+}
+
+#define LDCONFIG_FIRST_LINE(s) ldconfigFirstLine(__LINE__, s)
+#define LDCONFIG_LINE(s) ldconfigLine(__LINE__, s)
+#define LDCONFIG_LAST_LINE(s) ldconfigLastLine(__LINE__, s)
+#define WORD_SPACE_WORD(s) wordSpaceWord(__LINE__, s)
+#define TWO_WORDS(s) twoWords(__LINE__, s)
+#define KEY_VALUE(s) keyValue(__LINE__, s)
+#define SHARED_LIB_NAME(s) sharedLibName(__LINE__, s)
+
+
+void test_util_lineParsers() {
+	// `ldconfig -p` output, including localized (github issue #2).
+	LDCONFIG_FIRST_LINE("1234 libs found in cache `/etc/ld.so.cache'");
+	LDCONFIG_FIRST_LINE("1234 Bibliotheken wurden im Cache »/etc/ld.so.cache« gefunden");
+	LDCONFIG_FIRST_LINE("1234 bibliothèques trouvées dans le cache « /etc/ld.so.cache »");
+	LDCONFIG_FIRST_LINE("1234 библиотек найдено в кэше «/etc/ld.so.cache»");
+	LDCONFIG_FIRST_LINE("0 libs");
+	LDCONFIG_FIRST_LINE("999999999 libs");
+	LDCONFIG_FIRST_LINE("1234567890 libs");
+	LDCONFIG_FIRST_LINE("1234libs");
+	LDCONFIG_FIRST_LINE(" 1234 libs");
+	LDCONFIG_FIRST_LINE("1234 libs\r");
+	LDCONFIG_FIRST_LINE("1234 ");
+	LDCONFIG_FIRST_LINE("1234");
+	LDCONFIG_FIRST_LINE("");
+
+	LDCONFIG_LINE("\tlibz.so.1 (libc6,x86-64) => /usr/lib/libz.so.1");
+	LDCONFIG_LINE("\tlibz.so.1 (libc6) => /usr/lib32/libz.so.1");
+	LDCONFIG_LINE("\tld-linux.so.2 (ELF) => /usr/lib32/ld-linux.so.2");
+	LDCONFIG_LINE("\tlibc.so.6 (libc6,x86-64, OS ABI: Linux 3.2.0) => /usr/lib/libc.so.6");
+	LDCONFIG_LINE("\tlibfoo.so (libc6,x86-64) => usr/lib/libfoo.so");
+	LDCONFIG_LINE("\tlibfoo.so (libc6,x86-64) => /usr/lib/lib foo.so");
+	LDCONFIG_LINE("\tlibfoo.so (libc6,x86-64) => /");
+	LDCONFIG_LINE("\tlibfoo.so () => /usr/lib/libfoo.so");
+	LDCONFIG_LINE("\tlibfoo.so (a)b) => /usr/lib/libfoo.so");
+	LDCONFIG_LINE("\tlib foo.so (libc6) => /usr/lib/libfoo.so");
+	LDCONFIG_LINE(" libfoo.so (libc6) => /usr/lib/libfoo.so");
+	LDCONFIG_LINE("\t (libc6) => /usr/lib/libfoo.so");
+
+	LDCONFIG_LAST_LINE("Cache generated by: ldconfig (GNU libc) stable release version 2.36");
+	LDCONFIG_LAST_LINE("Cache erzeugt von: ldconfig (GNU libc) stable release version 2.36");
+	LDCONFIG_LAST_LINE("Кэш создан: ldconfig (GNU libc) stable release version 2.36");
+	LDCONFIG_LAST_LINE(" ldconfig (GNU libc)");
+	LDCONFIG_LAST_LINE("x ldconfig ");
+	LDCONFIG_LAST_LINE("x ldconfig");
+	LDCONFIG_LAST_LINE("xldconfig (GNU libc)");
+	LDCONFIG_LAST_LINE("");
+
+	// `pacman -Sw --print-format '%n %l'` output.
+	WORD_SPACE_WORD("libfoo file:///var/cache/pacman/pkg/libfoo-1.0-1-x86_64.pkg.tar.zst");
+	WORD_SPACE_WORD("libfoo https://mirror/libfoo-1.0-1-x86_64.pkg.tar.zst");
+	WORD_SPACE_WORD("libfoo  file:///x");
+	WORD_SPACE_WORD("libfoo file:///x ");
+	WORD_SPACE_WORD("libfoo file:///x y");
+	WORD_SPACE_WORD("libfoo\tfile:///x");
+	WORD_SPACE_WORD("libfoo");
+	WORD_SPACE_WORD(" x");
+	WORD_SPACE_WORD("");
+
+	// Config file addLibPath / addOptDepend / removeOptDepend values.
+	TWO_WORDS("gcc /usr/lib/gcc");
+	TWO_WORDS("  /opt/foo/** \t /opt/foo/lib  ");
+	TWO_WORDS("gcc");
+	TWO_WORDS("gcc /a /b");
+	TWO_WORDS("   ");
+	TWO_WORDS("");
+
+	// .PKGINFO lines.
+	KEY_VALUE("pkgname = libfoo");
+	KEY_VALUE("pkgver = 1.0-1");
+	KEY_VALUE("provides = libfoo.so=1-64");
+	KEY_VALUE("depend = glibc>=2.36");
+	KEY_VALUE("pkgdesc = Some = description  ");
+	KEY_VALUE("key=value");
+	KEY_VALUE("a=b=c");
+	KEY_VALUE("a==b");
+	KEY_VALUE("a= =b");
+	KEY_VALUE("a=b= ");
+	KEY_VALUE("a =");
+	KEY_VALUE("a = \r");
+	KEY_VALUE("a\r=\rb");
+	KEY_VALUE("=b");
+	KEY_VALUE("==b");
+	KEY_VALUE(" a = b");
+	KEY_VALUE("a b = c");
+	KEY_VALUE("");
+
+	// FilesCollector's library file names.
+	SHARED_LIB_NAME("libfoo.so");
+	SHARED_LIB_NAME("libfoo.so.1");
+	SHARED_LIB_NAME("libfoo.so.1.2.3");
+	SHARED_LIB_NAME("libfoo.so.");
+	SHARED_LIB_NAME("a.so.b.so");
+	SHARED_LIB_NAME("libfoo.sox.so.1");
+	SHARED_LIB_NAME("libfoo.sox");
+	SHARED_LIB_NAME(".so");
+	SHARED_LIB_NAME(".so.1");
+	SHARED_LIB_NAME("..so");
+	SHARED_LIB_NAME("libfoo.so\n");
+	SHARED_LIB_NAME("libfoo.a");
+	SHARED_LIB_NAME("");
+}
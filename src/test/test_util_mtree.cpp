@@ -0,0 +1,70 @@
+#undef NDEBUG
+
+#include <assert.h>
+#include <string>
+#include "../main/util/util.h"
+
+using namespace dimgel;
+
+
+static std::string symlinks(std::string_view text, bool expectedResult = true) {
+	std::string s;
+	bool ok = util::parseMtree(text, [&](const std::string& path1, std::string_view type, const std::string& link) {
+		if (type == "link") {
+			s.append(path1).append(" -> ").append(link).append("\n");
+		} else {
+			assert(link.empty());
+		}
+	});
+	assert(ok == expectedResult);
+	return s;
+}
+
+
+void test_util_mtree() {
+	// Like `bsdtar --format=mtree --options='!all,use-set,type,uid,gid,mode,time,size,md5,sha256,link'` output in Arch packages.
+	assert(symlinks(
+		"#mtree\n"
+		"/set type=file uid=0 gid=0 mode=644\n"
+		"./.PKGINFO time=1666793474.0 size=4798 md5digest=0 sha256digest=0\n"
+		"/set mode=755\n"
+		"./usr time=1666793474.0 type=dir\n"
+		"./usr/lib/libfoo.so time=1666793474.0 mode=777 type=link link=libfoo.so.1\n"
+		"./usr/lib/libfoo.so.1 time=1666793474.0 mode=777 type=link link=libfoo.so.1.2.3\n"
+		"./usr/lib/libfoo.so.1.2.3 time=1666793474.0 size=100\n"
+		"./usr/lib/lib\\040space.so time=1666793474.0 type=link link=../lib/a\\075b\\134c\n"
+	) ==
+		"usr/lib/libfoo.so -> libfoo.so.1\n"
+		"usr/lib/libfoo.so.1 -> libfoo.so.1.2.3\n"
+		"usr/lib/lib space.so -> ../lib/a=b\\c\n"
+	);
+
+	// Links as default type; /unset; line continuation.
+	assert(symlinks(
+		"/set type=link\n"
+		"./a link=b\n"
+		"./c type=file\n"
+		"/set uid=0\n"
+		"./d \\\n"
+		"    link=/e\n"
+		"/unset all\n"
+		"./f link=g\n"
+	) ==
+		"a -> b\n"
+		"d -> /e\n"
+	);
+
+	// Not supported: mtree v1 relative paths, unknown type in /set, bad escapes.
+	symlinks("usr type=dir\n", false);
+	symlinks("/set type=whatever\n", false);
+	symlinks("./a type=link link=b\\9\n", false);
+	symlinks("./a type=link link=b\\12\n", false);
+	assert(symlinks("") == "");
+
+	// Other entries' types.
+	std::string s;
+	assert(util::parseMtree("/set type=file\n./a\n./b type=dir\n/unset type\n./c\n", [&](const std::string& path1, std::string_view type, const std::string&) {
+		s.append(path1).append(":").append(type).append(" ");
+	}));
+	assert(s == "a:file b:dir c: ");
+}